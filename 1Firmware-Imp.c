@@ -1,190 +1,2649 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
-#define MAX_BUFFER_SIZE 20
+#define MAX_BUFFER_SIZE 32
 //This is microseconds. Sensors have to be fast.
+//Also the default (and smallest) ring size and the biggest batch published in one go.
+//The ring itself is sized at startup (--ring-slots), always a power of two so wrapping is a mask.
+#define CACHE_LINE_SIZE 64
+#define MAX_SENSOR_TYPES 64
+#define SENSOR_NAME_LENGTH 20
+
+//Load generator. MAX_PRODUCERS threads at most, latencies bucketed log-linear:
+//exact below 32 ns, then 16 sub-buckets per power of two (~6% wide).
+#define MAX_PRODUCERS 16
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_BUCKETS (64 << LATENCY_SUB_BUCKET_BITS)
+
+//Daemon mode: frames come in on a UNIX socket, a FIFO or stdin, get batched into the ring.
+//Binary frames start with these two bytes, which no text line can (text is "Type,value\n").
+#define FRAME_MAGIC_0 0xF5
+#define FRAME_MAGIC_1 0x1F
+#define DAEMON_BUFFER_SIZE 65536
+#define DAEMON_MAX_EVENTS 64
+#define DAEMON_REPORT_SECONDS 10
+#define DAEMON_NEW_TYPES_PER_CLIENT 4 //registry slots are permanent, one feed can't take them all
+
+//Rolling per-sensor stats over the last AGGREGATE_WINDOW_SECONDS, at most
+//AGGREGATE_WINDOW_CAPACITY readings per sensor (the window shrinks if a sensor is faster).
+#define AGGREGATE_WINDOW_SECONDS 60
+#define AGGREGATE_WINDOW_CAPACITY 4096
+#define HISTOGRAM_SHIFT 19
+#define HISTOGRAM_BUCKETS (1 << (32 - HISTOGRAM_SHIFT)) //sign, exponent, 4 mantissa bits, ~3% wide
+#define HISTOGRAM_GROUP_SHIFT 7                           //buckets are also counted in runs of 128
+#define HISTOGRAM_GROUPS (HISTOGRAM_BUCKETS >> HISTOGRAM_GROUP_SHIFT)
+#define ROLLING_STATS_RETRIES 16                          //then the query gives up instead of livelocking
+
+//Retention tiers past the raw ring: per sensor rollup rows of one minute and one hour.
+#define MINUTE_NS (60ull * 1000000000ull)
+#define HOUR_NS (60ull * MINUTE_NS)
+#define DEFAULT_MINUTE_ROWS (24 * 60)     //a day of minutes
+#define DEFAULT_HOUR_ROWS (30 * 24)       //a month of hours
+#define ROLLUP_MAGIC 0x4C4C4F52u //"ROLL"
+
+//On-disk history. Fixed size segments so position -> segment is a division.
+#define SEGMENT_DIR "sensor_segments"
+#define SENSOR_TYPES_FILE SEGMENT_DIR "/sensor_types.txt"
+#define ROLLUPS_FILE SEGMENT_DIR "/rollups.dat"
+#define CLEARED_FILE SEGMENT_DIR "/cleared.dat" //where 'c' last cleared, so a restart doesn't bring logs back
+#define CLEARED_MAGIC 0x524C4343u //"CCLR"
+#define SEGMENT_RECORDS 65536
+#define SEGMENT_MAGIC 0x474F4C53u //"SLOG"
+#define SEGMENT_VERSION 1
+#define LOG_FLAG_VALID 0x1 //set last, so a torn record after a crash is skipped
+
+//Cold storage. Sealed segments get rewritten Gorilla style (delta of delta times,
+//XOR'd floats) by a background thread and the raw file is dropped.
+#define COLD_MAGIC 0x524F4753u //"SGOR"
+#define COLD_VERSION 1
+#define COLD_TYPE_BITS 6
+#define COMPACTION_QUEUE_SIZE 16
 
 //WE start with sensor definitions. Not too harsh on reqs.
+//Fixed-size numeric record, the log id comes from the ring position and the
+//type name from the registry so nothing here is a string.
 typedef struct {
-    int sensor_id;
-    char sensor_type[20];
+    uint64_t timestamp_ns; //realtime nanoseconds, only turned into text when displayed
     float value;
-    char timestamp[30];
+    uint16_t sensor_type;  //id handed out by register_sensor_type
+    uint16_t flags;
 } sensor_log_t;
 
-//We can actually define a linked list in this way. Simplicity.
-typedef struct log_node {
-    sensor_log_t data;
-    struct log_node* next;
-    struct log_node* prev;
-} log_node_t;
+_Static_assert(sizeof(sensor_log_t) == 16, "sensor_log_t should stay a 16 byte record");
+
+//What a producer hands in, the ring adds the timestamp
+typedef struct {
+    uint16_t sensor_type;
+    float value;
+} sensor_reading_t;
+
+//Sensor type names get interned once, records only carry the small id.
+//Lookups read the published count without locking, registration is rare and takes the lock.
+typedef struct {
+    char names[MAX_SENSOR_TYPES][SENSOR_NAME_LENGTH];
+    _Atomic int count;
+    pthread_mutex_t lock;
+} sensor_registry_t;
+
+//One slot of the ring. stamp is position + 1 once the record is fully written,
+//0 while a producer is in the middle of (over)writing it.
+typedef struct {
+    _Atomic uint64_t stamp;
+    sensor_log_t data;
+} log_slot_t;
+
+//Fixed-capacity ring instead of a linked list. Producers claim a position with one
+//atomic add and old entries get overwritten by index, no malloc/free per reading.
+//Counters sit on their own cache lines so producers and readers don't false share.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t claimed;   //next position handed to a producer
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t committed; //every position below this is readable
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t consumed;  //every position below this is indexed and saved
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t cleared_at; //positions below this were cleared by 'c'
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t expired_before; //older than the raw time window
+    uint64_t last_timestamp_ns; //newest committed stamp, only touched by whoever holds the commit turn
+    _Alignas(CACHE_LINE_SIZE) log_slot_t* slots;
+    uint64_t capacity;          //power of two, fixed once init_log_ring ran
+    uint64_t mask;
+} log_ring_t;
+
+//How much history each tier keeps. Raw records live in the ring for at most raw_minutes
+//(0 = as long as the ring holds them), every reading is also folded into the minute rollups,
+//and minute rows that fall out of their tier get folded into hour rows.
+typedef struct {
+    uint64_t ring_slots;
+    uint64_t raw_minutes;
+    uint64_t minute_rows;
+    uint64_t hour_rows;
+} retention_config_t;
+
+//min/max/mean/count of one sensor over one minute or hour
+typedef struct {
+    uint64_t period_start_ns;
+    uint64_t count;
+    double sum;
+    float min;
+    float max;
+} rollup_row_t;
+
+//Closed rows are a ring readers can check like the type index, with one spare slot so the
+//oldest of the last capacity rows is never the one being overwritten. The open row is still
+//filling and is read under the owner's seqlock.
+typedef struct {
+    rollup_row_t* rows;         //capacity + 1 slots, row i at i % (capacity + 1)
+    uint64_t capacity;
+    _Atomic uint64_t count;
+    rollup_row_t open;
+} rollup_tier_t;
+
+typedef struct {
+    _Atomic uint32_t sequence; //odd while the ring consumer is changing an open row
+    rollup_tier_t minutes;
+    rollup_tier_t hours;
+} sensor_rollups_t;
+
+//Segment file = this header + SEGMENT_RECORDS records, memory mapped.
+//count is bumped after the records so after a crash only the tail past it needs checking.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t first_position;
+    uint32_t capacity;
+    uint32_t sealed;
+    _Atomic uint64_t count;
+    uint8_t reserved[32];
+} segment_header_t;
+
+_Static_assert(sizeof(segment_header_t) == 64, "segment header should fill one cache line");
+
+//Compressed segment file = this header + payload_bytes of bitstream
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t first_position;
+    uint64_t count;
+    uint64_t first_timestamp_ns;
+    uint64_t last_timestamp_ns; //lets range queries skip whole blocks
+    uint64_t payload_bytes;
+    uint8_t reserved[16];
+} cold_block_header_t;
+
+_Static_assert(sizeof(cold_block_header_t) == 64, "cold block header should fill one cache line");
+_Static_assert(MAX_SENSOR_TYPES <= (1 << COLD_TYPE_BITS), "sensor type ids must fit COLD_TYPE_BITS");
+
+//Sealed segments waiting to be compressed. Rotation pushes, the compactor thread pops.
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    uint64_t pending[COMPACTION_QUEUE_SIZE];
+    int pending_count;
+    int running;
+} compactor_t;
+
+//The one thread that trails committed and does everything a record needs after it's
+//readable: type index, rolling stats, rollups, segments, raw expiry. Each side only rings
+//the other's bell when it went to sleep, so while both are busy nobody makes a syscall.
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;          //consumer waits here for commits
+    pthread_cond_t space;         //producers wait here for the consumer to free slots
+    _Atomic int sleeping;
+    _Atomic int producers_waiting;
+    int running;
+} ring_consumer_t;
+
+//Only the ring consumer changes active and segment_no once the store is open; history
+//scans on other threads read them with acquire loads.
+typedef struct {
+    _Atomic int active;
+    _Atomic uint64_t segment_no; //segment currently mapped for appends
+    segment_header_t* header;
+    sensor_log_t* records;
+    FILE* types_file;           //registry names, one per line in id order
+    uint64_t recovered_segments;
+} log_store_t;
+
+//Per sensor type list of ring positions, oldest first. Lets queries binary search
+//one sensor's readings by time instead of walking every log. Same capacity as the ring
+//since nothing older than the ring can be pointed at anyway.
+typedef struct {
+    uint64_t* _Atomic positions; //log_ring.capacity entries, allocated when the type is first seen
+    _Atomic uint64_t count;      //entries ever added, entry i lives at i & log_ring.mask
+} type_index_t;
+
+//Sliding window for one sensor type, updated on ingest so queries are O(1) for
+//count/mean/min/max and a short two level histogram walk for percentiles.
+//Only the ring consumer writes it. Readers look at the summary fields under the seqlock,
+//never the window itself, so a read is a few hundred loads and rarely has to retry.
+typedef struct {
+    _Atomic uint32_t sequence;            //odd while the writer is mid-update
+    uint64_t count;                       //summary: what readers may look at
+    double sum;
+    float min, max;
+    uint32_t histogram_groups[HISTOGRAM_GROUPS];
+    uint32_t histogram[HISTOGRAM_BUCKETS];
+    uint64_t head, tail;                  //window is entries [head, tail), slot = index % capacity
+    float values[AGGREGATE_WINDOW_CAPACITY];
+    uint64_t timestamps[AGGREGATE_WINDOW_CAPACITY];
+    uint64_t min_head, min_tail;          //monotonic deque of entry indices, values increasing
+    uint64_t min_deque[AGGREGATE_WINDOW_CAPACITY];
+    uint64_t max_head, max_tail;          //same, values decreasing
+    uint64_t max_deque[AGGREGATE_WINDOW_CAPACITY];
+} rolling_stats_t;
+
+//What the query hands back
+typedef struct {
+    uint64_t count;
+    double mean;
+    float min;
+    float max;
+    float p50;
+    float p99;
+} rolling_summary_t;
+
+//What a rollup query hands back, plus how many rows it had to touch to get there
+typedef struct {
+    uint64_t count;
+    double mean;
+    float min;
+    float max;
+    uint64_t minute_rows;
+    uint64_t hour_rows;
+} rollup_summary_t;
+
+//A record together with where it sits, what the queries hand back
+typedef struct {
+    uint64_t position;
+    sensor_log_t log;
+} log_entry_t;
+
+//A reader's place in the ring. Each reader owns its own, so navigation needs no shared state
+//and no lock: it only ever reads the ring through the per-slot seqlock.
+typedef struct {
+    uint64_t position;
+} log_cursor_t;
+
+//GLobal vars
+static log_ring_t log_ring;
+static retention_config_t retention = { MAX_BUFFER_SIZE, 0, DEFAULT_MINUTE_ROWS, DEFAULT_HOUR_ROWS };
+static type_index_t type_indexes[MAX_SENSOR_TYPES];
+static sensor_rollups_t* _Atomic sensor_rollups[MAX_SENSOR_TYPES];
+static rolling_stats_t* _Atomic rolling_stats[MAX_SENSOR_TYPES]; //allocated the first time a type is seen
+static sensor_registry_t sensor_registry = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static log_store_t log_store;
+static compactor_t compactor = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER };
+static ring_consumer_t ring_consumer = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER,
+                                         .space = PTHREAD_COND_INITIALIZER };
+static log_cursor_t current_log; //the menu's cursor
+
+int system_running = 1;
+
+//Spin a little, then give the core away. A producer we are waiting on may be
+//preempted and spinning on it forever helps nobody (single core gateways!).
+static inline void spin_wait(int* spins) {
+    if (++*spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+#define TIMESTAMP_TEXT_LENGTH 40
+
+//One clock read, no localtime/strftime on the insert path
+uint64_t get_timestamp_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+//For measuring durations, never stored
+uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+//Lazy formatting, for display and exports only
+void format_timestamp(uint64_t timestamp_ns, char *buffer, size_t length) {
+    time_t seconds = (time_t)(timestamp_ns / 1000000000ull);
+    struct tm t;
+    localtime_r(&seconds, &t);
+    size_t used = strftime(buffer, length, "%Y-%m-%d %H:%M:%S", &t);
+    snprintf(buffer + used, length - used, ".%09u", (unsigned)(timestamp_ns % 1000000000ull));
+}
+
+//Sizes the ring to the configured slot count rounded up to a power of two. Called once at startup.
+int init_log_ring(uint64_t slots) {
+    uint64_t capacity = MAX_BUFFER_SIZE;
+    while (capacity < slots) capacity <<= 1;
+    log_ring.slots = (log_slot_t*)aligned_alloc(CACHE_LINE_SIZE, capacity * sizeof(log_slot_t));
+    if (!log_ring.slots) return 0;
+    memset(log_ring.slots, 0, capacity * sizeof(log_slot_t));
+    log_ring.capacity = capacity;
+    log_ring.mask = capacity - 1;
+    return 1;
+}
+
+//Oldest position still in the ring (not overwritten, not past the raw time window, not cleared)
+uint64_t oldest_log_position(uint64_t committed) {
+    uint64_t oldest = committed > log_ring.capacity ? committed - log_ring.capacity : 0;
+    uint64_t expired = atomic_load_explicit(&log_ring.expired_before, memory_order_acquire);
+    uint64_t cleared = atomic_load_explicit(&log_ring.cleared_at, memory_order_acquire);
+    if (expired > oldest) oldest = expired;
+    return cleared > oldest ? cleared : oldest;
+}
+
+//Copies the record at pos out of the ring. Returns 0 if it was overwritten under us.
+int read_log_at(uint64_t pos, sensor_log_t* out) {
+    log_slot_t* slot = &log_ring.slots[pos & log_ring.mask];
+    uint64_t before = atomic_load_explicit(&slot->stamp, memory_order_acquire);
+    if (before != pos + 1) return 0;
+    memcpy(out, &slot->data, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->stamp, memory_order_relaxed) == before;
+}
+
+//Only ever called by the ring consumer (or startup replay, before it starts)
+static void index_by_type(const sensor_log_t* record, uint64_t pos) {
+    if (record->sensor_type >= MAX_SENSOR_TYPES) return;
+    type_index_t* index = &type_indexes[record->sensor_type];
+    uint64_t* positions = atomic_load_explicit(&index->positions, memory_order_relaxed);
+    if (!positions) {
+        positions = (uint64_t*)malloc(log_ring.capacity * sizeof(uint64_t));
+        if (!positions) return;
+        atomic_store_explicit(&index->positions, positions, memory_order_release);
+    }
+    uint64_t entry = atomic_load_explicit(&index->count, memory_order_relaxed);
+    positions[entry & log_ring.mask] = pos;
+    atomic_store_explicit(&index->count, entry + 1, memory_order_release);
+}
+
+int find_sensor_type(const char* name) {
+    int count = atomic_load_explicit(&sensor_registry.count, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(sensor_registry.names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+//Returns the id for name, adding it if it's new. -1 once the registry is full.
+int register_sensor_type(const char* name) {
+    int id = find_sensor_type(name);
+    if (id != -1) return id;
+
+    pthread_mutex_lock(&sensor_registry.lock);
+    id = find_sensor_type(name);
+    if (id == -1) {
+        int count = atomic_load_explicit(&sensor_registry.count, memory_order_relaxed);
+        if (count < MAX_SENSOR_TYPES) {
+            strncpy(sensor_registry.names[count], name, SENSOR_NAME_LENGTH - 1);
+            sensor_registry.names[count][SENSOR_NAME_LENGTH - 1] = '\0';
+            atomic_store_explicit(&sensor_registry.count, count + 1, memory_order_release);
+            id = count;
+            //Records on disk only have the id, so the name has to be on disk too
+            if (log_store.types_file) {
+                fprintf(log_store.types_file, "%s\n", sensor_registry.names[count]);
+                fflush(log_store.types_file);
+            }
+        }
+    }
+    pthread_mutex_unlock(&sensor_registry.lock);
+    return id;
+}
+
+const char* sensor_type_name(uint16_t sensor_type) {
+    if (sensor_type >= atomic_load_explicit(&sensor_registry.count, memory_order_acquire)) return "Unknown";
+    return sensor_registry.names[sensor_type];
+}
+
+size_t segment_file_size(void) {
+    return sizeof(segment_header_t) + (size_t)SEGMENT_RECORDS * sizeof(sensor_log_t);
+}
+
+void segment_path(uint64_t segment_no, char* buffer, size_t length) {
+    snprintf(buffer, length, SEGMENT_DIR "/seg_%08llu.dat", (unsigned long long)segment_no);
+}
+
+//Maps segment_no, creating and sizing the file first if asked to. NULL on failure.
+segment_header_t* map_segment(uint64_t segment_no, int create) {
+    char path[64];
+    segment_path(segment_no, path, sizeof(path));
+    int fd = open(path, create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    if (fd == -1) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || ((size_t)st.st_size < segment_file_size() && ftruncate(fd, segment_file_size()) == -1)) {
+        close(fd);
+        return NULL;
+    }
+    void* mapped = mmap(NULL, segment_file_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return NULL;
+
+    segment_header_t* header = (segment_header_t*)mapped;
+    if (header->magic != SEGMENT_MAGIC) {
+        //Fresh file (zero filled by ftruncate)
+        header->version = SEGMENT_VERSION;
+        header->first_position = segment_no * SEGMENT_RECORDS;
+        header->capacity = SEGMENT_RECORDS;
+        header->sealed = 0;
+        atomic_store(&header->count, 0);
+        header->magic = SEGMENT_MAGIC;
+    } else if (header->version != SEGMENT_VERSION || header->capacity != SEGMENT_RECORDS) {
+        munmap(mapped, segment_file_size());
+        return NULL;
+    }
+    return header;
+}
+
+void unmap_segment(segment_header_t* header, int sync) {
+    msync(header, segment_file_size(), sync ? MS_SYNC : MS_ASYNC);
+    munmap(header, segment_file_size());
+}
+
+sensor_log_t* segment_records(segment_header_t* header) {
+    return (sensor_log_t*)(header + 1);
+}
+
+//The header count can trail the records by whatever was in flight when we died,
+//walk forward over fully written records to find the real end.
+uint64_t recover_segment_count(segment_header_t* header) {
+    sensor_log_t* records = segment_records(header);
+    uint64_t count = atomic_load(&header->count);
+    while (count < SEGMENT_RECORDS && (records[count].flags & LOG_FLAG_VALID)) count++;
+    atomic_store(&header->count, count);
+    return count;
+}
+
+//Bit streams for the cold format, most significant bit first. At most 32 bits per call.
+typedef struct {
+    uint8_t* out;
+    size_t bytes;
+    uint64_t buffer;
+    int buffered;
+} bit_writer_t;
+
+typedef struct {
+    const uint8_t* in;
+    size_t bytes;
+    size_t pos;
+    uint64_t buffer;
+    int buffered;
+} bit_reader_t;
+
+static inline void write_bits(bit_writer_t* w, uint32_t value, int bits) {
+    w->buffer = (w->buffer << bits) | value;
+    w->buffered += bits;
+    while (w->buffered >= 8) {
+        w->buffered -= 8;
+        w->out[w->bytes++] = (uint8_t)(w->buffer >> w->buffered);
+    }
+}
+
+static inline void flush_bits(bit_writer_t* w) {
+    if (w->buffered > 0) write_bits(w, 0, 8 - w->buffered);
+}
+
+static inline uint32_t read_bits(bit_reader_t* r, int bits) {
+    while (r->buffered < bits) {
+        r->buffer = (r->buffer << 8) | (r->pos < r->bytes ? r->in[r->pos++] : 0);
+        r->buffered += 8;
+    }
+    r->buffered -= bits;
+    return (uint32_t)(r->buffer >> r->buffered) & (uint32_t)((1ull << bits) - 1);
+}
+
+//Per sensor type XOR state, each sensor is its own float series
+typedef struct {
+    uint32_t previous;
+    int leading;   //-1 until the first non-zero XOR
+    int trailing;
+} xor_state_t;
+
+//Same shape on both sides so encoder and decoder can't drift apart
+typedef struct {
+    uint64_t previous_timestamp;
+    int64_t previous_delta;
+    uint16_t previous_type;
+    xor_state_t values[MAX_SENSOR_TYPES];
+} gorilla_state_t;
+
+static void reset_gorilla_state(gorilla_state_t* state) {
+    memset(state, 0, sizeof(*state));
+    for (int i = 0; i < MAX_SENSOR_TYPES; i++) state->values[i].leading = -1;
+}
+
+static void encode_record(bit_writer_t* w, gorilla_state_t* state, const sensor_log_t* record, int first) {
+    //Type: '0' same as the previous record, else '1' + id
+    if (!first && record->sensor_type == state->previous_type) {
+        write_bits(w, 0, 1);
+    } else {
+        write_bits(w, 1, 1);
+        write_bits(w, record->sensor_type, COLD_TYPE_BITS);
+    }
+    state->previous_type = record->sensor_type;
+
+    //Time: full stamp once, then zigzagged delta of delta in growing buckets.
+    //Timestamps are non-decreasing along positions, batches share one, so '0' is common.
+    if (first) {
+        write_bits(w, (uint32_t)(record->timestamp_ns >> 32), 32);
+        write_bits(w, (uint32_t)record->timestamp_ns, 32);
+        state->previous_delta = 0;
+    } else {
+        int64_t delta = (int64_t)(record->timestamp_ns - state->previous_timestamp);
+        int64_t dod = delta - state->previous_delta;
+        uint64_t zigzag = ((uint64_t)dod << 1) ^ (uint64_t)(dod >> 63);
+        if (zigzag == 0) {
+            write_bits(w, 0, 1);
+        } else if (zigzag < (1ull << 8)) {
+            write_bits(w, 0x2, 2);
+            write_bits(w, (uint32_t)zigzag, 8);
+        } else if (zigzag < (1ull << 16)) {
+            write_bits(w, 0x6, 3);
+            write_bits(w, (uint32_t)zigzag, 16);
+        } else if (zigzag < (1ull << 24)) {
+            write_bits(w, 0xE, 4);
+            write_bits(w, (uint32_t)zigzag, 24);
+        } else if (zigzag < (1ull << 32)) {
+            write_bits(w, 0x1E, 5);
+            write_bits(w, (uint32_t)zigzag, 32);
+        } else {
+            write_bits(w, 0x1F, 5);
+            write_bits(w, (uint32_t)(zigzag >> 32), 32);
+            write_bits(w, (uint32_t)zigzag, 32);
+        }
+        state->previous_delta = delta;
+    }
+    state->previous_timestamp = record->timestamp_ns;
+
+    //Value: XOR against this sensor's previous value, only the meaningful bits go out
+    xor_state_t* series = &state->values[record->sensor_type];
+    uint32_t bits;
+    memcpy(&bits, &record->value, sizeof(bits));
+    uint32_t xored = bits ^ series->previous;
+    series->previous = bits;
+    if (xored == 0) {
+        write_bits(w, 0, 1);
+        return;
+    }
+    int leading = __builtin_clz(xored);
+    int trailing = __builtin_ctz(xored);
+    if (leading > 31) leading = 31;
+    if (series->leading != -1 && leading >= series->leading && trailing >= series->trailing) {
+        write_bits(w, 0x2, 2);
+        write_bits(w, xored >> series->trailing, 32 - series->leading - series->trailing);
+    } else {
+        int meaningful = 32 - leading - trailing;
+        write_bits(w, 0x3, 2);
+        write_bits(w, (uint32_t)leading, 5);
+        write_bits(w, (uint32_t)(meaningful - 1), 5);
+        write_bits(w, xored >> trailing, meaningful);
+        series->leading = leading;
+        series->trailing = trailing;
+    }
+}
+
+//Returns 0 if the bits can't have come from encode_record (a damaged block), record is
+//garbage then and nothing after it in the block can be trusted either.
+static int decode_record(bit_reader_t* r, gorilla_state_t* state, sensor_log_t* record, int first) {
+    if (read_bits(r, 1)) state->previous_type = (uint16_t)read_bits(r, COLD_TYPE_BITS);
+    record->sensor_type = state->previous_type;
+
+    if (first) {
+        uint64_t high = read_bits(r, 32);
+        record->timestamp_ns = (high << 32) | read_bits(r, 32);
+        state->previous_delta = 0;
+    } else {
+        uint64_t zigzag = 0;
+        if (read_bits(r, 1)) {
+            if (!read_bits(r, 1)) zigzag = read_bits(r, 8);
+            else if (!read_bits(r, 1)) zigzag = read_bits(r, 16);
+            else if (!read_bits(r, 1)) zigzag = read_bits(r, 24);
+            else if (!read_bits(r, 1)) zigzag = read_bits(r, 32);
+            else {
+                uint64_t high = read_bits(r, 32);
+                zigzag = (high << 32) | read_bits(r, 32);
+            }
+        }
+        int64_t dod = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        //Wraps the way the encoder's subtraction did; only damaged bits can get that far
+        state->previous_delta = (int64_t)((uint64_t)state->previous_delta + (uint64_t)dod);
+        record->timestamp_ns = state->previous_timestamp + (uint64_t)state->previous_delta;
+    }
+    state->previous_timestamp = record->timestamp_ns;
+
+    xor_state_t* series = &state->values[record->sensor_type % MAX_SENSOR_TYPES];
+    if (read_bits(r, 1)) {
+        uint32_t xored;
+        if (!read_bits(r, 1)) {
+            //Reusing a window the encoder never opened
+            if (series->leading < 0) return 0;
+            xored = read_bits(r, 32 - series->leading - series->trailing) << series->trailing;
+        } else {
+            int leading = (int)read_bits(r, 5);
+            int meaningful = (int)read_bits(r, 5) + 1;
+            if (leading + meaningful > 32) return 0;
+            series->leading = leading;
+            series->trailing = 32 - leading - meaningful;
+            xored = read_bits(r, meaningful) << series->trailing;
+        }
+        series->previous ^= xored;
+    }
+    memcpy(&record->value, &series->previous, sizeof(record->value));
+    record->flags = LOG_FLAG_VALID;
+    return 1;
+}
+
+void cold_segment_path(uint64_t segment_no, char* buffer, size_t length) {
+    snprintf(buffer, length, SEGMENT_DIR "/seg_%08llu.gor", (unsigned long long)segment_no);
+}
+
+//Streams a sealed raw segment through the encoder into seg_N.gor, then drops the raw file.
+//Written to a temp name and renamed, so a .gor that exists is always complete.
+int compact_segment(uint64_t segment_no) {
+    segment_header_t* header = map_segment(segment_no, 0);
+    if (!header) return 0;
+    uint64_t count = recover_segment_count(header);
+    sensor_log_t* records = segment_records(header);
+
+    //Worst case a record costs 15 bytes, never more than raw
+    uint8_t* payload = (uint8_t*)malloc(count * sizeof(sensor_log_t) + 8);
+    if (!payload) {
+        unmap_segment(header, 0);
+        return 0;
+    }
+    bit_writer_t writer = { payload, 0, 0, 0 };
+    gorilla_state_t state;
+    reset_gorilla_state(&state);
+    for (uint64_t i = 0; i < count; i++) {
+        encode_record(&writer, &state, &records[i], i == 0);
+    }
+    flush_bits(&writer);
+
+    cold_block_header_t block = {0};
+    block.magic = COLD_MAGIC;
+    block.version = COLD_VERSION;
+    block.first_position = segment_no * SEGMENT_RECORDS;
+    block.count = count;
+    block.first_timestamp_ns = count ? records[0].timestamp_ns : 0;
+    block.last_timestamp_ns = count ? records[count - 1].timestamp_ns : 0;
+    block.payload_bytes = writer.bytes;
+    unmap_segment(header, 0);
+
+    char path[64], temp_path[72], raw_path[64];
+    cold_segment_path(segment_no, path, sizeof(path));
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    segment_path(segment_no, raw_path, sizeof(raw_path));
+
+    FILE* file = fopen(temp_path, "wb");
+    int ok = file != NULL &&
+             fwrite(&block, sizeof(block), 1, file) == 1 &&
+             fwrite(payload, 1, writer.bytes, file) == writer.bytes &&
+             fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (file) fclose(file);
+    free(payload);
+    if (!ok || rename(temp_path, path) == -1) {
+        unlink(temp_path);
+        return 0;
+    }
+    unlink(raw_path);
+    return 1;
+}
+
+void *compactor_function(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&compactor.lock);
+    for (;;) {
+        while (compactor.running && compactor.pending_count == 0) {
+            pthread_cond_wait(&compactor.wake, &compactor.lock);
+        }
+        if (compactor.pending_count == 0) break; //stopped and drained
+        uint64_t segment_no = compactor.pending[0];
+        compactor.pending_count--;
+        memmove(compactor.pending, compactor.pending + 1, compactor.pending_count * sizeof(uint64_t));
+        pthread_mutex_unlock(&compactor.lock);
+        compact_segment(segment_no);
+        pthread_mutex_lock(&compactor.lock);
+    }
+    pthread_mutex_unlock(&compactor.lock);
+    return NULL;
+}
+
+void start_compactor(void) {
+    compactor.running = 1;
+    pthread_create(&compactor.thread, NULL, compactor_function, NULL);
+}
+
+//Lets the compactor finish what's queued so nothing is left half done
+void stop_compactor(void) {
+    pthread_mutex_lock(&compactor.lock);
+    compactor.running = 0;
+    pthread_cond_signal(&compactor.wake);
+    pthread_mutex_unlock(&compactor.lock);
+    pthread_join(compactor.thread, NULL);
+}
+
+//Rotation calls this from the ring consumer, so it must not wait on the compactor.
+//If the queue is full the segment just stays raw until the next startup picks it up.
+void queue_compaction(uint64_t segment_no) {
+    pthread_mutex_lock(&compactor.lock);
+    if (compactor.running && compactor.pending_count < COMPACTION_QUEUE_SIZE) {
+        compactor.pending[compactor.pending_count++] = segment_no;
+        pthread_cond_signal(&compactor.wake);
+    }
+    pthread_mutex_unlock(&compactor.lock);
+}
+
+//Reads a cold block's header. 0 if there's no (valid) compressed file for that segment.
+int read_cold_header(uint64_t segment_no, cold_block_header_t* block, FILE** file_out) {
+    char path[64];
+    cold_segment_path(segment_no, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    if (fread(block, sizeof(*block), 1, file) != 1 || block->magic != COLD_MAGIC || block->version != COLD_VERSION) {
+        fclose(file);
+        return 0;
+    }
+    if (file_out) *file_out = file;
+    else fclose(file);
+    return 1;
+}
+
+//Every record of a saved segment, raw or compressed, into out (room for SEGMENT_RECORDS).
+//Returns how many, 0 if the segment isn't there.
+uint64_t load_segment_records(uint64_t segment_no, sensor_log_t* out) {
+    cold_block_header_t block;
+    FILE* file;
+    if (read_cold_header(segment_no, &block, &file)) {
+        uint8_t* payload = (uint8_t*)malloc(block.payload_bytes);
+        uint64_t count = 0;
+        if (payload && fread(payload, 1, block.payload_bytes, file) == block.payload_bytes) {
+            bit_reader_t reader = { payload, block.payload_bytes, 0, 0, 0 };
+            gorilla_state_t state;
+            reset_gorilla_state(&state);
+            for (count = 0; count < block.count && count < SEGMENT_RECORDS; count++) {
+                if (!decode_record(&reader, &state, &out[count], count == 0)) break;
+            }
+        }
+        free(payload);
+        fclose(file);
+        return count;
+    }
+
+    segment_header_t* header = map_segment(segment_no, 0);
+    if (!header) return 0;
+    uint64_t count = recover_segment_count(header);
+    memcpy(out, segment_records(header), count * sizeof(sensor_log_t));
+    unmap_segment(header, 0);
+    return count;
+}
+
+typedef void (*history_visitor_t)(uint64_t position, const sensor_log_t* log, void* context);
+
+//Walks all saved history stamped within [from_ns, to_ns] in position order.
+//Compressed blocks outside the range are skipped on their header alone and decoding stops
+//at the first record past to_ns; raw segments are binary searched. Returns records visited.
+uint64_t scan_saved_history(uint64_t from_ns, uint64_t to_ns, history_visitor_t visit, void* context) {
+    if (!atomic_load_explicit(&log_store.active, memory_order_acquire)) return 0;
+    uint64_t visited = 0;
+    uint8_t* payload = NULL;
+
+    //Segments rotated in after this are newer than anything the scan was asked about
+    uint64_t newest = atomic_load_explicit(&log_store.segment_no, memory_order_acquire);
+    //Records 'c' cleared stay on disk but are never shown again
+    uint64_t cleared = atomic_load_explicit(&log_ring.cleared_at, memory_order_acquire);
+    for (uint64_t segment_no = cleared / SEGMENT_RECORDS; segment_no <= newest; segment_no++) {
+        uint64_t first_position = segment_no * SEGMENT_RECORDS;
+        cold_block_header_t block;
+        FILE* file;
+
+        if (read_cold_header(segment_no, &block, &file)) {
+            if (block.count == 0 || block.last_timestamp_ns < from_ns || block.first_timestamp_ns > to_ns) {
+                fclose(file);
+                continue;
+            }
+            uint8_t* grown = (uint8_t*)realloc(payload, block.payload_bytes);
+            if (!grown || fread(grown, 1, block.payload_bytes, file) != block.payload_bytes) {
+                if (grown) payload = grown;
+                fclose(file);
+                continue;
+            }
+            payload = grown;
+            fclose(file);
+
+            bit_reader_t reader = { payload, block.payload_bytes, 0, 0, 0 };
+            gorilla_state_t state;
+            reset_gorilla_state(&state);
+            sensor_log_t record;
+            for (uint64_t i = 0; i < block.count; i++) {
+                if (!decode_record(&reader, &state, &record, i == 0)) break;
+                if (record.timestamp_ns > to_ns) break;
+                if (record.timestamp_ns < from_ns || first_position + i < cleared) continue;
+                visit(first_position + i, &record, context);
+                visited++;
+            }
+            continue;
+        }
+
+        //Raw: a sealed one the compactor hasn't reached yet, or the active one
+        segment_header_t* header = map_segment(segment_no, 0);
+        if (!header) continue;
+        sensor_log_t* records = segment_records(header);
+        uint64_t count = atomic_load_explicit(&header->count, memory_order_acquire);
+        uint64_t low = cleared > first_position ? cleared - first_position : 0, high = count;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            if (records[middle].timestamp_ns < from_ns) low = middle + 1;
+            else high = middle;
+        }
+        for (uint64_t i = low; i < count && records[i].timestamp_ns <= to_ns; i++) {
+            visit(first_position + i, &records[i], context);
+            visited++;
+        }
+        munmap(header, segment_file_size());
+    }
+    free(payload);
+    return visited;
+}
+
+//Only the ring consumer calls this, so segments are written by one thread in position order.
+//Plain stores into the mapping, no syscall except on rotation.
+void persist_records(uint64_t pos, uint64_t count) {
+    while (count > 0) {
+        uint64_t segment_no = pos / SEGMENT_RECORDS;
+        if (segment_no != log_store.segment_no) {
+            //Rotation: seal the full segment, hand it to the compactor and start the next one
+            log_store.header->sealed = 1;
+            unmap_segment(log_store.header, 0);
+            queue_compaction(log_store.segment_no);
+            log_store.header = map_segment(segment_no, 1);
+            if (!log_store.header) {
+                printf("Error: couldn't create log segment %llu, persistence stopped.\n", (unsigned long long)segment_no);
+                atomic_store_explicit(&log_store.active, 0, memory_order_release);
+                return;
+            }
+            atomic_store_explicit(&log_store.segment_no, segment_no, memory_order_release);
+            log_store.records = segment_records(log_store.header);
+        }
+
+        uint64_t offset = pos % SEGMENT_RECORDS;
+        uint64_t chunk = SEGMENT_RECORDS - offset < count ? SEGMENT_RECORDS - offset : count;
+        for (uint64_t i = 0; i < chunk; i++) {
+            sensor_log_t* record = &log_store.records[offset + i];
+            *record = log_ring.slots[(pos + i) & log_ring.mask].data;
+            record->flags = 0;
+            atomic_thread_fence(memory_order_release);
+            record->flags = LOG_FLAG_VALID;
+        }
+        atomic_store_explicit(&log_store.header->count, offset + chunk, memory_order_release);
+        pos += chunk;
+        count -= chunk;
+    }
+}
+
+//Puts the newest records from disk back into the ring so navigation works after a restart.
+//Only touches the last one or two segments, never the whole history.
+void replay_ring_tail(uint64_t total) {
+    uint64_t replay = total < log_ring.capacity ? total : log_ring.capacity;
+    uint64_t first = total - replay;
+    uint64_t cleared = atomic_load(&log_ring.cleared_at);
+    if (first < cleared) first = cleared;
+    sensor_log_t* previous = NULL;
+
+    //Tail spills into the segment before, which may already be compressed.
+    //Big rings could reach further back, but one segment is plenty to browse after a restart.
+    uint64_t segment_start = log_store.segment_no * SEGMENT_RECORDS;
+    if (first < segment_start) {
+        if (first < segment_start - SEGMENT_RECORDS) first = segment_start - SEGMENT_RECORDS;
+        previous = (sensor_log_t*)malloc((size_t)SEGMENT_RECORDS * sizeof(sensor_log_t));
+        if (!previous || load_segment_records(log_store.segment_no - 1, previous) != SEGMENT_RECORDS) {
+            first = segment_start;
+        }
+    }
+    for (uint64_t pos = first; pos < total; pos++) {
+        log_slot_t* slot = &log_ring.slots[pos & log_ring.mask];
+        slot->data = pos / SEGMENT_RECORDS == log_store.segment_no
+                   ? log_store.records[pos % SEGMENT_RECORDS]
+                   : previous[pos % SEGMENT_RECORDS];
+        atomic_store_explicit(&slot->stamp, pos + 1, memory_order_relaxed);
+        log_ring.last_timestamp_ns = slot->data.timestamp_ns;
+        index_by_type(&slot->data, pos);
+    }
+    free(previous);
+
+    atomic_store(&log_ring.claimed, total);
+    atomic_store(&log_ring.consumed, total);
+    atomic_store(&log_ring.expired_before, first);
+    atomic_store_explicit(&log_ring.committed, total, memory_order_release);
+}
+
+//Appends a closed row, handing back the row it pushed out of a full tier (returns 0 if none)
+static int push_rollup_row(rollup_tier_t* tier, const rollup_row_t* row, rollup_row_t* displaced) {
+    uint64_t count = atomic_load_explicit(&tier->count, memory_order_relaxed);
+    int full = count >= tier->capacity;
+    if (full) *displaced = tier->rows[(count - tier->capacity) % (tier->capacity + 1)];
+    tier->rows[count % (tier->capacity + 1)] = *row;
+    atomic_store_explicit(&tier->count, count + 1, memory_order_release);
+    return full;
+}
+
+static void merge_rollup_row(rollup_row_t* into, const rollup_row_t* from) {
+    if (into->count == 0 || from->min < into->min) into->min = from->min;
+    if (into->count == 0 || from->max > into->max) into->max = from->max;
+    into->count += from->count;
+    into->sum += from->sum;
+}
+
+//Minute rows aging out of their tier get folded into the open hour row, hour rows aging
+//out of theirs are gone. Each row is touched once on the way down, so it's all O(1) amortized.
+static void fold_into_hours(sensor_rollups_t* rollups, const rollup_row_t* minute) {
+    rollup_tier_t* hours = &rollups->hours;
+    uint64_t hour = minute->period_start_ns / HOUR_NS * HOUR_NS;
+    if (hours->open.count && hours->open.period_start_ns != hour) {
+        rollup_row_t dropped;
+        push_rollup_row(hours, &hours->open, &dropped);
+        hours->open.count = 0;
+    }
+    if (!hours->open.count) {
+        hours->open = *minute;
+        hours->open.period_start_ns = hour;
+    } else {
+        merge_rollup_row(&hours->open, minute);
+    }
+}
+
+static sensor_rollups_t* rollups_for_type(uint16_t sensor_type) {
+    sensor_rollups_t* rollups = atomic_load_explicit(&sensor_rollups[sensor_type], memory_order_relaxed);
+    if (rollups) return rollups;
+    rollups = (sensor_rollups_t*)calloc(1, sizeof(sensor_rollups_t));
+    if (!rollups) return NULL;
+    rollups->minutes.capacity = retention.minute_rows;
+    rollups->hours.capacity = retention.hour_rows;
+    rollups->minutes.rows = (rollup_row_t*)calloc(retention.minute_rows + 1, sizeof(rollup_row_t));
+    rollups->hours.rows = (rollup_row_t*)calloc(retention.hour_rows + 1, sizeof(rollup_row_t));
+    if (!rollups->minutes.rows || !rollups->hours.rows) {
+        free(rollups->minutes.rows);
+        free(rollups->hours.rows);
+        free(rollups);
+        return NULL;
+    }
+    atomic_store_explicit(&sensor_rollups[sensor_type], rollups, memory_order_release);
+    return rollups;
+}
+
+//Rollups only change in memory, so they're written out whole on a clean shutdown. Per sensor:
+//type id, then each tier's closed rows oldest first followed by its open row. Hours go first
+//so loading can push minute rows back through the normal fold.
+int save_rollups(void) {
+    FILE* file = fopen(ROLLUPS_FILE ".tmp", "wb");
+    if (!file) return 0;
+    uint32_t magic = ROLLUP_MAGIC;
+    int ok = fwrite(&magic, sizeof(magic), 1, file) == 1;
+    for (uint16_t type = 0; ok && type < MAX_SENSOR_TYPES; type++) {
+        sensor_rollups_t* rollups = atomic_load_explicit(&sensor_rollups[type], memory_order_acquire);
+        if (!rollups) continue;
+        ok = fwrite(&type, sizeof(type), 1, file) == 1;
+        rollup_tier_t* tiers[2] = { &rollups->hours, &rollups->minutes };
+        for (int t = 0; ok && t < 2; t++) {
+            uint64_t count = atomic_load(&tiers[t]->count);
+            uint64_t first = count > tiers[t]->capacity ? count - tiers[t]->capacity : 0;
+            uint64_t rows = count - first;
+            ok = fwrite(&rows, sizeof(rows), 1, file) == 1;
+            for (uint64_t i = first; ok && i < count; i++) {
+                ok = fwrite(&tiers[t]->rows[i % (tiers[t]->capacity + 1)], sizeof(rollup_row_t), 1, file) == 1;
+            }
+            ok = ok && fwrite(&tiers[t]->open, sizeof(rollup_row_t), 1, file) == 1;
+        }
+    }
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!ok || rename(ROLLUPS_FILE ".tmp", ROLLUPS_FILE) == -1) {
+        unlink(ROLLUPS_FILE ".tmp");
+        return 0;
+    }
+    return 1;
+}
+
+//Tier sizes may have changed since the save; rows that no longer fit fold down (minutes) or drop (hours).
+void load_rollups(void) {
+    FILE* file = fopen(ROLLUPS_FILE, "rb");
+    if (!file) return;
+    uint32_t magic = 0;
+    uint16_t type;
+    if (fread(&magic, sizeof(magic), 1, file) != 1 || magic != ROLLUP_MAGIC) {
+        fclose(file);
+        return;
+    }
+    while (fread(&type, sizeof(type), 1, file) == 1 && type < MAX_SENSOR_TYPES) {
+        sensor_rollups_t* rollups = rollups_for_type(type);
+        if (!rollups) break;
+        rollup_row_t row, displaced;
+        uint64_t rows;
+        int ok = 1;
+
+        ok = fread(&rows, sizeof(rows), 1, file) == 1;
+        for (uint64_t i = 0; ok && i < rows; i++) {
+            if ((ok = fread(&row, sizeof(row), 1, file) == 1)) push_rollup_row(&rollups->hours, &row, &displaced);
+        }
+        ok = ok && fread(&rollups->hours.open, sizeof(rollup_row_t), 1, file) == 1;
+
+        ok = ok && fread(&rows, sizeof(rows), 1, file) == 1;
+        for (uint64_t i = 0; ok && i < rows; i++) {
+            if ((ok = fread(&row, sizeof(row), 1, file) == 1) &&
+                push_rollup_row(&rollups->minutes, &row, &displaced)) {
+                fold_into_hours(rollups, &displaced);
+            }
+        }
+        ok = ok && fread(&rollups->minutes.open, sizeof(rollup_row_t), 1, file) == 1;
+        if (!ok) break;
+    }
+    fclose(file);
+}
+
+//Written whenever 'c' clears, same temp file and rename as the rollups so a crash
+//leaves either the old position or the new one
+int save_cleared_at(uint64_t position) {
+    FILE* file = fopen(CLEARED_FILE ".tmp", "wb");
+    if (!file) return 0;
+    uint32_t magic = CLEARED_MAGIC;
+    int ok = fwrite(&magic, sizeof(magic), 1, file) == 1 && fwrite(&position, sizeof(position), 1, file) == 1;
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!ok || rename(CLEARED_FILE ".tmp", CLEARED_FILE) == -1) {
+        unlink(CLEARED_FILE ".tmp");
+        return 0;
+    }
+    return 1;
+}
+
+//0 (nothing cleared) without a valid file
+uint64_t load_cleared_at(void) {
+    FILE* file = fopen(CLEARED_FILE, "rb");
+    if (!file) return 0;
+    uint32_t magic = 0;
+    uint64_t position = 0;
+    if (fread(&magic, sizeof(magic), 1, file) != 1 || magic != CLEARED_MAGIC ||
+        fread(&position, sizeof(position), 1, file) != 1) {
+        position = 0;
+    }
+    fclose(file);
+    return position;
+}
+
+//Startup is O(segments): list the directory, recover the newest segment's tail, replay into the ring.
+int open_log_store(void) {
+    if (mkdir(SEGMENT_DIR, 0755) == -1 && errno != EEXIST) {
+        printf("Error: couldn't create '%s', logs won't be saved.\n", SEGMENT_DIR);
+        return 0;
+    }
+
+    //Type ids first, records refer to them
+    FILE* types = fopen(SENSOR_TYPES_FILE, "r");
+    if (types) {
+        char name[SENSOR_NAME_LENGTH + 2];
+        while (fgets(name, sizeof(name), types) != NULL) {
+            name[strcspn(name, "\n")] = '\0';
+            if (strlen(name) > 0) register_sensor_type(name);
+        }
+        fclose(types);
+    }
+    log_store.types_file = fopen(SENSOR_TYPES_FILE, "a");
+    load_rollups();
+
+    start_compactor();
+
+    uint64_t newest = 0;
+    uint64_t segments = 0;
+    DIR* dir = opendir(SEGMENT_DIR);
+    if (dir) {
+        struct dirent* entry;
+        unsigned long long segment_no;
+        char extension[8];
+        while ((entry = readdir(dir)) != NULL) {
+            if (sscanf(entry->d_name, "seg_%llu.%7s", &segment_no, extension) == 2 &&
+                (strcmp(extension, "dat") == 0 || strcmp(extension, "gor") == 0)) {
+                if (segment_no > newest) newest = segment_no;
+                segments++;
+            }
+        }
+        closedir(dir);
+    }
+
+    //Raw segments left behind before the newest (crash or full queue) still need compressing.
+    //A .gor is only ever complete, so if both exist the raw one is just stale.
+    if (dir) {
+        dir = opendir(SEGMENT_DIR);
+        struct dirent* entry;
+        unsigned long long segment_no;
+        char extension[8];
+        while (dir && (entry = readdir(dir)) != NULL) {
+            if (sscanf(entry->d_name, "seg_%llu.%7s", &segment_no, extension) == 2 &&
+                strcmp(extension, "dat") == 0 && segment_no < newest) {
+                if (read_cold_header(segment_no, &(cold_block_header_t){0}, NULL)) {
+                    char raw_path[64];
+                    segment_path(segment_no, raw_path, sizeof(raw_path));
+                    unlink(raw_path);
+                    segments--;
+                } else {
+                    queue_compaction(segment_no);
+                }
+            }
+        }
+        if (dir) closedir(dir);
+    }
+
+    log_store.header = map_segment(newest, 1);
+    if (!log_store.header) {
+        printf("Error: couldn't map log segment %llu, logs won't be saved.\n", (unsigned long long)newest);
+        stop_compactor();
+        return 0;
+    }
+    log_store.segment_no = newest;
+    log_store.records = segment_records(log_store.header);
+    log_store.recovered_segments = segments;
+
+    uint64_t total = newest * SEGMENT_RECORDS + recover_segment_count(log_store.header);
+    uint64_t cleared = load_cleared_at();
+    atomic_store(&log_ring.cleared_at, cleared < total ? cleared : total);
+    replay_ring_tail(total);
+    log_store.active = 1;
+    return 1;
+}
+
+void close_log_store(void) {
+    if (!log_store.active) return;
+    log_store.active = 0;
+    unmap_segment(log_store.header, 1);
+    if (!save_rollups()) printf("Error: couldn't save '%s'.\n", ROLLUPS_FILE);
+
+    stop_compactor();
+    if (log_store.types_file) fclose(log_store.types_file);
+}
+
+//Floats ordered as unsigned ints (negatives flipped), top bits pick the bucket
+static inline uint32_t histogram_bucket(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    return bits >> HISTOGRAM_SHIFT;
+}
+
+//Middle of a bucket, what percentiles report
+float histogram_bucket_value(uint32_t bucket) {
+    uint32_t bits = (bucket << HISTOGRAM_SHIFT) | (1u << (HISTOGRAM_SHIFT - 1));
+    bits = (bits & 0x80000000u) ? bits & 0x7FFFFFFFu : ~bits;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void drop_oldest_from_window(rolling_stats_t* stats) {
+    uint64_t entry = stats->head++;
+    float value = stats->values[entry % AGGREGATE_WINDOW_CAPACITY];
+    uint32_t bucket = histogram_bucket(value);
+    stats->sum -= value;
+    stats->histogram[bucket]--;
+    stats->histogram_groups[bucket >> HISTOGRAM_GROUP_SHIFT]--;
+    if (stats->min_head < stats->min_tail && stats->min_deque[stats->min_head % AGGREGATE_WINDOW_CAPACITY] == entry) stats->min_head++;
+    if (stats->max_head < stats->max_tail && stats->max_deque[stats->max_head % AGGREGATE_WINDOW_CAPACITY] == entry) stats->max_head++;
+}
+
+//O(1) amortized: each reading enters and leaves the window and both deques once
+static void update_rolling_stats(const sensor_log_t* record) {
+    if (record->sensor_type >= MAX_SENSOR_TYPES) return;
+    rolling_stats_t* stats = atomic_load_explicit(&rolling_stats[record->sensor_type], memory_order_relaxed);
+    if (!stats) {
+        stats = (rolling_stats_t*)calloc(1, sizeof(rolling_stats_t));
+        if (!stats) return;
+        atomic_store_explicit(&rolling_stats[record->sensor_type], stats, memory_order_release);
+    }
+
+    atomic_store_explicit(&stats->sequence, atomic_load_explicit(&stats->sequence, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    uint64_t window_start = record->timestamp_ns > AGGREGATE_WINDOW_SECONDS * 1000000000ull
+                          ? record->timestamp_ns - AGGREGATE_WINDOW_SECONDS * 1000000000ull : 0;
+    while (stats->head < stats->tail &&
+           (stats->tail - stats->head >= AGGREGATE_WINDOW_CAPACITY ||
+            stats->timestamps[stats->head % AGGREGATE_WINDOW_CAPACITY] < window_start)) {
+        drop_oldest_from_window(stats);
+    }
+
+    uint64_t entry = stats->tail++;
+    stats->values[entry % AGGREGATE_WINDOW_CAPACITY] = record->value;
+    stats->timestamps[entry % AGGREGATE_WINDOW_CAPACITY] = record->timestamp_ns;
+    uint32_t bucket = histogram_bucket(record->value);
+    stats->sum += record->value;
+    stats->histogram[bucket]++;
+    stats->histogram_groups[bucket >> HISTOGRAM_GROUP_SHIFT]++;
+
+    while (stats->min_tail > stats->min_head &&
+           stats->values[stats->min_deque[(stats->min_tail - 1) % AGGREGATE_WINDOW_CAPACITY] % AGGREGATE_WINDOW_CAPACITY] >= record->value) {
+        stats->min_tail--;
+    }
+    stats->min_deque[stats->min_tail++ % AGGREGATE_WINDOW_CAPACITY] = entry;
+    while (stats->max_tail > stats->max_head &&
+           stats->values[stats->max_deque[(stats->max_tail - 1) % AGGREGATE_WINDOW_CAPACITY] % AGGREGATE_WINDOW_CAPACITY] <= record->value) {
+        stats->max_tail--;
+    }
+    stats->max_deque[stats->max_tail++ % AGGREGATE_WINDOW_CAPACITY] = entry;
+
+    stats->count = stats->tail - stats->head;
+    stats->min = stats->values[stats->min_deque[stats->min_head % AGGREGATE_WINDOW_CAPACITY] % AGGREGATE_WINDOW_CAPACITY];
+    stats->max = stats->values[stats->max_deque[stats->max_head % AGGREGATE_WINDOW_CAPACITY] % AGGREGATE_WINDOW_CAPACITY];
+    atomic_store_explicit(&stats->sequence, atomic_load_explicit(&stats->sequence, memory_order_relaxed) + 1, memory_order_release);
+}
+
+//Every committed reading lands in its sensor's open minute row. Producers can't lap a slot
+//the consumer hasn't passed yet, so the raw copy is still there when this runs.
+static void update_rollups(const sensor_log_t* record) {
+    if (record->sensor_type >= MAX_SENSOR_TYPES) return;
+    sensor_rollups_t* rollups = rollups_for_type(record->sensor_type);
+    if (!rollups) return;
+
+    atomic_store_explicit(&rollups->sequence, atomic_load_explicit(&rollups->sequence, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    rollup_tier_t* minutes = &rollups->minutes;
+    uint64_t minute = record->timestamp_ns / MINUTE_NS * MINUTE_NS;
+    if (minutes->open.count && minutes->open.period_start_ns != minute) {
+        rollup_row_t displaced;
+        if (push_rollup_row(minutes, &minutes->open, &displaced)) fold_into_hours(rollups, &displaced);
+        minutes->open.count = 0;
+    }
+    rollup_row_t reading = { minute, 1, record->value, record->value, record->value };
+    if (!minutes->open.count) minutes->open = reading;
+    else merge_rollup_row(&minutes->open, &reading);
+
+    atomic_store_explicit(&rollups->sequence, atomic_load_explicit(&rollups->sequence, memory_order_relaxed) + 1, memory_order_release);
+}
+
+//Raw tier time limit. Timestamps only go up along positions, so this just walks forward.
+static void expire_raw_records(uint64_t committed, uint64_t newest_ns) {
+    if (!retention.raw_minutes) return;
+    uint64_t window = retention.raw_minutes * MINUTE_NS;
+    uint64_t cutoff = newest_ns > window ? newest_ns - window : 0;
+    uint64_t expired = atomic_load_explicit(&log_ring.expired_before, memory_order_relaxed);
+    if (committed > log_ring.capacity && expired < committed - log_ring.capacity) expired = committed - log_ring.capacity;
+    sensor_log_t log;
+    while (expired < committed && (!read_log_at(expired, &log) || log.timestamp_ns < cutoff)) expired++;
+    atomic_store_explicit(&log_ring.expired_before, expired, memory_order_release);
+}
+
+//Everything a committed record still needs, in position order. Runs on the consumer only.
+static void consume_records(uint64_t pos, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        const sensor_log_t* record = &log_ring.slots[(pos + i) & log_ring.mask].data;
+        index_by_type(record, pos + i);
+        update_rolling_stats(record);
+        update_rollups(record);
+    }
+    if (log_store.active) persist_records(pos, count);
+    expire_raw_records(pos + count, log_ring.slots[(pos + count - 1) & log_ring.mask].data.timestamp_ns);
+}
+
+//Spins briefly while producers are busy, sleeps once they go quiet
+void *ring_consumer_function(void *arg) {
+    (void)arg;
+    uint64_t pos = atomic_load_explicit(&log_ring.consumed, memory_order_relaxed);
+    int spins = 0;
+    for (;;) {
+        uint64_t committed = atomic_load_explicit(&log_ring.committed, memory_order_acquire);
+        if (committed == pos) {
+            if (spins < 64) {
+                spin_wait(&spins);
+                continue;
+            }
+            pthread_mutex_lock(&ring_consumer.lock);
+            //Say we're asleep before the last look, a producer committing now will see it
+            atomic_store(&ring_consumer.sleeping, 1);
+            while (ring_consumer.running && atomic_load(&log_ring.committed) == pos) {
+                pthread_cond_wait(&ring_consumer.wake, &ring_consumer.lock);
+            }
+            atomic_store(&ring_consumer.sleeping, 0);
+            int stopped = !ring_consumer.running;
+            pthread_mutex_unlock(&ring_consumer.lock);
+            if (stopped && atomic_load(&log_ring.committed) == pos) break; //stopped and drained
+            spins = 0;
+            continue;
+        }
+        //Hand slots back a batch at a time so producers waiting on a full ring move early
+        uint64_t count = committed - pos < MAX_BUFFER_SIZE ? committed - pos : MAX_BUFFER_SIZE;
+        consume_records(pos, count);
+        pos += count;
+        atomic_store(&log_ring.consumed, pos);
+        if (atomic_load(&ring_consumer.producers_waiting)) {
+            pthread_mutex_lock(&ring_consumer.lock);
+            pthread_cond_broadcast(&ring_consumer.space);
+            pthread_mutex_unlock(&ring_consumer.lock);
+        }
+        spins = 0;
+    }
+    return NULL;
+}
+
+void start_ring_consumer(void) {
+    ring_consumer.running = 1;
+    pthread_create(&ring_consumer.thread, NULL, ring_consumer_function, NULL);
+}
+
+//Producers must be gone by now. Everything they committed is indexed and saved before this returns.
+void stop_ring_consumer(void) {
+    pthread_mutex_lock(&ring_consumer.lock);
+    ring_consumer.running = 0;
+    pthread_cond_signal(&ring_consumer.wake);
+    pthread_mutex_unlock(&ring_consumer.lock);
+    pthread_join(ring_consumer.thread, NULL);
+}
+
+//Blocks until everything committed so far is indexed, so a query right after an insert sees it
+void wait_for_ring_consumer(void) {
+    uint64_t committed = atomic_load_explicit(&log_ring.committed, memory_order_acquire);
+    int spins = 0;
+    while (atomic_load_explicit(&log_ring.consumed, memory_order_acquire) < committed) {
+        spin_wait(&spins);
+    }
+}
+
+//Ring is a full lap ahead of the consumer. Sleeping instead of yielding matters on a single
+//core: a yield hands the CPU to whoever is runnable, not to the consumer we wait on.
+static void wait_for_ring_space(uint64_t last) {
+    pthread_mutex_lock(&ring_consumer.lock);
+    atomic_fetch_add(&ring_consumer.producers_waiting, 1);
+    while (last - atomic_load(&log_ring.consumed) >= log_ring.capacity) {
+        pthread_cond_wait(&ring_consumer.space, &ring_consumer.lock);
+    }
+    atomic_fetch_sub(&ring_consumer.producers_waiting, 1);
+    pthread_mutex_unlock(&ring_consumer.lock);
+}
+
+//Reserves count consecutive slots, fills them with one shared timestamp and
+//publishes them with a single store so readers see all of them or none.
+//count must not exceed MAX_BUFFER_SIZE (and so never the ring's capacity).
+static void append_to_ring(const sensor_reading_t* readings, uint64_t count, uint64_t timestamp_ns) {
+    uint64_t pos = atomic_fetch_add_explicit(&log_ring.claimed, count, memory_order_relaxed);
+    uint64_t last = pos + count - 1;
+
+    //Our last slot still holds the previous lap until the consumer is past it, wait it out
+    int spins = 0;
+    while (last - atomic_load_explicit(&log_ring.consumed, memory_order_acquire) >= log_ring.capacity) {
+        if (spins < 64) spin_wait(&spins);
+        else wait_for_ring_space(last);
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        log_slot_t* slot = &log_ring.slots[(pos + i) & log_ring.mask];
+        //Seqlock style: mark the slot as being written, fill it, then stamp it
+        atomic_store_explicit(&slot->stamp, 0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        slot->data.sensor_type = readings[i].sensor_type;
+        slot->data.flags = 0;
+        slot->data.value = readings[i].value;
+        slot->data.timestamp_ns = timestamp_ns;
+        atomic_store_explicit(&slot->stamp, pos + i + 1, memory_order_release);
+    }
+
+    //Publish in claim order so committed is always a contiguous prefix. The turn is only
+    //held to keep timestamps non-decreasing along positions (a producer that read the clock
+    //earlier can commit later), which is what makes binary search on time valid.
+    spins = 0;
+    while (atomic_load_explicit(&log_ring.committed, memory_order_acquire) != pos) {
+        spin_wait(&spins);
+    }
+    if (timestamp_ns < log_ring.last_timestamp_ns) {
+        for (uint64_t i = 0; i < count; i++) {
+            log_ring.slots[(pos + i) & log_ring.mask].data.timestamp_ns = log_ring.last_timestamp_ns;
+        }
+    } else {
+        log_ring.last_timestamp_ns = timestamp_ns;
+    }
+    //Pairs with the consumer's sleeping flag: one of us always sees the other's store
+    atomic_store(&log_ring.committed, pos + count);
+    if (atomic_load(&ring_consumer.sleeping)) {
+        pthread_mutex_lock(&ring_consumer.lock);
+        pthread_cond_signal(&ring_consumer.wake);
+        pthread_mutex_unlock(&ring_consumer.lock);
+    }
+}
+
+void add_sensor_log(uint16_t sensor_type, float value) {
+    sensor_reading_t reading = { sensor_type, value };
+    append_to_ring(&reading, 1, get_timestamp_ns());
+}
+
+//Gateways deliver bursts. One clock read and one reservation per MAX_BUFFER_SIZE chunk.
+void add_sensor_log_batch(const sensor_reading_t* readings, size_t count) {
+    uint64_t timestamp_ns = get_timestamp_ns();
+    while (count > 0) {
+        size_t chunk = count < MAX_BUFFER_SIZE ? count : MAX_BUFFER_SIZE;
+        append_to_ring(readings, chunk, timestamp_ns);
+        readings += chunk;
+        count -= chunk;
+    }
+}
 
-//GLobal vars
-log_node_t* head = NULL;
-log_node_t* tail = NULL;
-log_node_t* current_log = NULL;
-int log_count = 0;
-int log_counter = 1;
-
-//Sync prerequsities. Pthread is surprisingly necessary due to mutex.
-pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
-int live_stream_active = 0;
-int system_running = 1;
 
-void get_timestamp(char *buffer) {
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(buffer, 30, "%Y-%m-%d %H:%M:%S", t);
+//Reads entry i of a sensor's index. 0 if it was recycled or its record is gone from the ring.
+int read_type_index_entry(uint16_t sensor_type, uint64_t entry, log_entry_t* out) {
+    type_index_t* index = &type_indexes[sensor_type];
+    uint64_t* positions = atomic_load_explicit(&index->positions, memory_order_acquire);
+    if (!positions) return 0;
+    out->position = positions[entry & log_ring.mask];
+    atomic_thread_fence(memory_order_acquire);
+    //The writer fills entry + capacity before counting it, so this catches a recycled entry
+    if (atomic_load_explicit(&index->count, memory_order_relaxed) >= entry + log_ring.capacity) return 0;
+    //Never past committed, so a query can't see part of a batch that isn't published yet
+    uint64_t committed = atomic_load_explicit(&log_ring.committed, memory_order_acquire);
+    if (out->position >= committed) return 0;
+    if (out->position < oldest_log_position(committed)) return 0;
+    return read_log_at(out->position, &out->log) && out->log.sensor_type == sensor_type;
 }
 
-void add_sensor_log(const char* sensor_type, float value) {
-    pthread_mutex_lock(&list_mutex);
-    
-    //Creating new node
-    log_node_t* new_node = (log_node_t*)malloc(sizeof(log_node_t));
-    new_node->data.sensor_id = log_counter++;
-    strcpy(new_node->data.sensor_type, sensor_type);
-    new_node->data.value = value;
-    get_timestamp(new_node->data.timestamp);
-    new_node->next = NULL;
-    new_node->prev = tail;
-    
-    if (log_count >= MAX_BUFFER_SIZE) {
-        log_node_t* old_head = head;
-        head = head->next;
-        if (head) head->prev = NULL;
-        if (current_log == old_head) current_log = head;
-        free(old_head);
-        log_count--;
+//First position in the ring stamped at or after timestamp_ns (committed if none)
+uint64_t find_position_by_time(uint64_t timestamp_ns) {
+    uint64_t committed = atomic_load_explicit(&log_ring.committed, memory_order_acquire);
+    uint64_t low = oldest_log_position(committed);
+    uint64_t high = committed;
+    sensor_log_t log;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        //Overwritten while we looked means it was older than anything left, go right
+        if (!read_log_at(middle, &log) || log.timestamp_ns < timestamp_ns) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
     }
-    
-    if (tail) tail->next = new_node;
-    tail = new_node;
-    if (!head) {
-        head = new_node;
-        current_log = new_node;
+    return low;
+}
+
+//All readings of one sensor type stamped within [from_ns, to_ns], oldest first.
+//Binary search in that type's index, then a walk over matching entries only.
+size_t query_sensor_range(uint16_t sensor_type, uint64_t from_ns, uint64_t to_ns, log_entry_t* out, size_t max_entries) {
+    if (sensor_type >= MAX_SENSOR_TYPES) return 0;
+    type_index_t* index = &type_indexes[sensor_type];
+    uint64_t count = atomic_load_explicit(&index->count, memory_order_acquire);
+    uint64_t low = count > log_ring.capacity ? count - log_ring.capacity : 0;
+    uint64_t high = count;
+    log_entry_t entry;
+
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (!read_type_index_entry(sensor_type, middle, &entry) || entry.log.timestamp_ns < from_ns) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    size_t found = 0;
+    for (uint64_t i = low; i < count && found < max_entries; i++) {
+        if (!read_type_index_entry(sensor_type, i, &entry)) continue;
+        if (entry.log.timestamp_ns > to_ns) break;
+        out[found++] = entry;
+    }
+    return found;
+}
+
+//Newest max_entries readings of one sensor type, newest first
+size_t query_latest_readings(uint16_t sensor_type, log_entry_t* out, size_t max_entries) {
+    if (sensor_type >= MAX_SENSOR_TYPES) return 0;
+    uint64_t count = atomic_load_explicit(&type_indexes[sensor_type].count, memory_order_acquire);
+    uint64_t low = count > log_ring.capacity ? count - log_ring.capacity : 0;
+    size_t found = 0;
+    for (uint64_t i = count; i > low && found < max_entries; i--) {
+        if (!read_type_index_entry(sensor_type, i - 1, &out[found])) break;
+        found++;
+    }
+    return found;
+}
+
+//Bucket holding the rank-th smallest reading in the window: whole groups first, then
+//buckets inside one group. Always in range even if a racing writer tears what we read.
+static uint32_t histogram_rank_bucket(const rolling_stats_t* stats, uint64_t rank) {
+    uint64_t seen = 0;
+    uint32_t group = 0;
+    while (group < HISTOGRAM_GROUPS - 1 && seen + stats->histogram_groups[group] < rank) {
+        seen += stats->histogram_groups[group++];
+    }
+    uint32_t bucket = group << HISTOGRAM_GROUP_SHIFT;
+    uint32_t last = bucket + (1u << HISTOGRAM_GROUP_SHIFT) - 1;
+    while (bucket < last && seen + stats->histogram[bucket] < rank) {
+        seen += stats->histogram[bucket++];
+    }
+    return bucket;
+}
+
+//Stats for the window ending at the sensor's newest reading. 0 if the sensor has none,
+//-1 if it kept changing under us for ROLLING_STATS_RETRIES tries (ask again later).
+//Readers retry instead of locking, so they never hold up the ingest path.
+int query_rolling_stats(uint16_t sensor_type, rolling_summary_t* out) {
+    if (sensor_type >= MAX_SENSOR_TYPES) return 0;
+    rolling_stats_t* stats = atomic_load_explicit(&rolling_stats[sensor_type], memory_order_acquire);
+    if (!stats) return 0;
+
+    for (int attempt = 0; attempt < ROLLING_STATS_RETRIES; attempt++) {
+        uint32_t before = atomic_load_explicit(&stats->sequence, memory_order_acquire);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        uint64_t count = stats->count;
+        double sum = stats->sum;
+        float min = stats->min;
+        float max = stats->max;
+        uint32_t p50_bucket = 0, p99_bucket = 0;
+        if (count) {
+            p50_bucket = histogram_rank_bucket(stats, (count - 1) / 2 + 1);
+            p99_bucket = histogram_rank_bucket(stats, (count * 99 + 99) / 100);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&stats->sequence, memory_order_relaxed) != before) continue;
+
+        out->count = count;
+        if (count == 0) return 0;
+        out->mean = sum / (double)count;
+        out->min = min;
+        out->max = max;
+        //Bucket midpoints can land outside what was actually seen
+        out->p50 = histogram_bucket_value(p50_bucket);
+        out->p99 = histogram_bucket_value(p99_bucket);
+        if (out->p50 < out->min) out->p50 = out->min;
+        if (out->p50 > out->max) out->p50 = out->max;
+        if (out->p99 < out->min) out->p99 = out->min;
+        if (out->p99 > out->max) out->p99 = out->max;
+        return 1;
+    }
+    return -1;
+}
+
+//Closed row i of a tier, 0 if the tier has already recycled it
+static int read_rollup_row(rollup_tier_t* tier, uint64_t i, rollup_row_t* out) {
+    *out = tier->rows[i % (tier->capacity + 1)];
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&tier->count, memory_order_relaxed) <= i + tier->capacity;
+}
+
+//Merges the closed rows of one tier overlapping [from_ns, to_ns). Rows are in time order,
+//so binary search to the first and stop at the first one past the range.
+static int merge_tier_rows(rollup_tier_t* tier, uint64_t count, uint64_t period_ns, uint64_t from_ns, uint64_t to_ns,
+                           rollup_row_t* total, uint64_t* rows) {
+    uint64_t low = count > tier->capacity ? count - tier->capacity : 0;
+    uint64_t high = count;
+    rollup_row_t row;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (!read_rollup_row(tier, mid, &row)) return 0;
+        if (row.period_start_ns + period_ns <= from_ns) low = mid + 1;
+        else high = mid;
+    }
+    for (uint64_t i = low; i < count; i++) {
+        if (!read_rollup_row(tier, i, &row)) return 0;
+        if (row.period_start_ns >= to_ns) break;
+        merge_rollup_row(total, &row);
+        (*rows)++;
+    }
+    return 1;
+}
+
+//Long range stats for one sensor from the minute and hour rollups, never the raw records.
+//Every reading sits in exactly one row, hour rows cover what minute rows no longer do, so
+//summing the overlapping rows of both tiers is the answer. The range is rounded out to
+//whole rows. Returns 0 when nothing falls in it.
+int query_rollups(uint16_t sensor_type, uint64_t from_ns, uint64_t to_ns, rollup_summary_t* out) {
+    if (sensor_type >= MAX_SENSOR_TYPES) return 0;
+    sensor_rollups_t* rollups = atomic_load_explicit(&sensor_rollups[sensor_type], memory_order_acquire);
+    if (!rollups) return 0;
+
+    for (;;) {
+        //Open rows and closed counts from the same moment, so no row is counted twice or missed
+        rollup_row_t open_minute, open_hour;
+        uint64_t minutes, hours;
+        for (;;) {
+            uint32_t before = atomic_load_explicit(&rollups->sequence, memory_order_acquire);
+            if (before & 1) {
+                sched_yield();
+                continue;
+            }
+            open_minute = rollups->minutes.open;
+            open_hour = rollups->hours.open;
+            minutes = atomic_load_explicit(&rollups->minutes.count, memory_order_acquire);
+            hours = atomic_load_explicit(&rollups->hours.count, memory_order_acquire);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&rollups->sequence, memory_order_relaxed) == before) break;
+        }
+
+        rollup_row_t total = {0};
+        out->minute_rows = out->hour_rows = 0;
+        //A row recycled mid scan means the tiers moved under us, start over
+        if (!merge_tier_rows(&rollups->hours, hours, HOUR_NS, from_ns, to_ns, &total, &out->hour_rows)) continue;
+        if (open_hour.count && open_hour.period_start_ns < to_ns && open_hour.period_start_ns + HOUR_NS > from_ns) {
+            merge_rollup_row(&total, &open_hour);
+            out->hour_rows++;
+        }
+        if (!merge_tier_rows(&rollups->minutes, minutes, MINUTE_NS, from_ns, to_ns, &total, &out->minute_rows)) continue;
+        if (open_minute.count && open_minute.period_start_ns < to_ns && open_minute.period_start_ns + MINUTE_NS > from_ns) {
+            merge_rollup_row(&total, &open_minute);
+            out->minute_rows++;
+        }
+
+        out->count = total.count;
+        if (total.count == 0) return 0;
+        out->mean = total.sum / (double)total.count;
+        out->min = total.min;
+        out->max = total.max;
+        return 1;
+    }
+}
+
+void print_log_entry(uint64_t position, const sensor_log_t* log) {
+    char timestamp[TIMESTAMP_TEXT_LENGTH];
+    format_timestamp(log->timestamp_ns, timestamp, sizeof(timestamp));
+    //Numbered from the last clear; callers never pass a cleared position
+    printf("[Log #%llu] %s | Value: %.2f | Time: %s\n",
+           (unsigned long long)(position - atomic_load_explicit(&log_ring.cleared_at, memory_order_acquire)) + 1,
+           sensor_type_name(log->sensor_type),
+           log->value,
+           timestamp);
+}
+
+//Moves the cursor by step (0 to just re-read) and copies out the record it lands on in the
+//same go, so what gets shown is exactly where the cursor is even if producers are lapping us.
+//Returns 1 if it moved (or for step 0, if there's anything), 0 at the ends or when empty.
+int cursor_step(log_cursor_t* cursor, int step, sensor_log_t* out) {
+    for (;;) {
+        uint64_t committed = atomic_load_explicit(&log_ring.committed, memory_order_acquire);
+        uint64_t oldest = oldest_log_position(committed);
+        if (committed == oldest) return 0;
+        //Cursor fell off the back of the ring, same as the old head being freed
+        if (cursor->position < oldest) cursor->position = oldest;
+        if (cursor->position >= committed) cursor->position = committed - 1;
+
+        uint64_t target = cursor->position;
+        if (step > 0 && target + 1 >= committed) return 0;
+        if (step < 0 && target <= oldest) return 0;
+        target += step;
+        //Overwritten between the bounds check and the copy: re-clamp and go again
+        if (read_log_at(target, out)) {
+            cursor->position = target;
+            return 1;
+        }
+    }
+}
+
+//Copies the newest (up to) max_entries records as one consistent view: exactly the
+//committed records at positions [first, last) for a single committed value, oldest first.
+//Entries evicted while copying are dropped from the front rather than retried.
+size_t take_log_snapshot(log_entry_t* out, size_t max_entries) {
+    uint64_t committed = atomic_load_explicit(&log_ring.committed, memory_order_acquire);
+    uint64_t oldest = oldest_log_position(committed);
+    uint64_t first = committed - oldest > max_entries ? committed - max_entries : oldest;
+    size_t copied = 0;
+    for (uint64_t pos = first; pos < committed; pos++) {
+        if (!read_log_at(pos, &out[copied].log)) {
+            copied = 0; //this and everything before it has been lapped
+            continue;
+        }
+        out[copied++].position = pos;
     }
-    log_count++;
-    pthread_mutex_unlock(&list_mutex);
+    return copied;
 }
 
 void display_current_log() {
-    pthread_mutex_lock(&list_mutex);
-    if (current_log) {
-        printf("\n[Log #%d] %s | Value: %.2f | Time: %s\n",
-               current_log->data.sensor_id,
-               current_log->data.sensor_type,
-               current_log->data.value,
-               current_log->data.timestamp);
-    } else {
+    sensor_log_t log;
+    if (!cursor_step(&current_log, 0, &log)) {
         printf("\nNo logs available.\n");
+        return;
     }
-    pthread_mutex_unlock(&list_mutex);
+    printf("\n");
+    print_log_entry(current_log.position, &log);
 }
 
 void navigate_next() {
-    pthread_mutex_lock(&list_mutex);
-    if (current_log && current_log->next) {
-        current_log = current_log->next;
-        pthread_mutex_unlock(&list_mutex);
-        display_current_log();
+    sensor_log_t log;
+    if (cursor_step(&current_log, 1, &log)) {
+        printf("\n");
+        print_log_entry(current_log.position, &log);
     } else {
-        pthread_mutex_unlock(&list_mutex);
         printf("\nAlready at the most recent log.\n");
     }
 }
 
 void navigate_previous() {
-    pthread_mutex_lock(&list_mutex);
-    if (current_log && current_log->prev) {
-        current_log = current_log->prev;
-        pthread_mutex_unlock(&list_mutex);
-        display_current_log();
+    sensor_log_t log;
+    if (cursor_step(&current_log, -1, &log)) {
+        printf("\n");
+        print_log_entry(current_log.position, &log);
     } else {
-        pthread_mutex_unlock(&list_mutex);
         printf("\nAlready at the oldest log.\n");
     }
 }
 
 void clear_all_logs() {
-    pthread_mutex_lock(&list_mutex);
-    log_node_t* current = head;
-    while (current != NULL) {
-        log_node_t* next = current->next;
-        free(current);
-        current = next;
-    }
-    head = tail = current_log = NULL;
-    log_count = 0;
-    log_counter = 1;
-    pthread_mutex_unlock(&list_mutex);
+    //Nothing to free anymore, just move the visible window past everything committed.
+    //The records stay in their segments; the saved position keeps them hidden after a restart.
+    uint64_t committed = atomic_load_explicit(&log_ring.committed, memory_order_acquire);
+    atomic_store_explicit(&log_ring.cleared_at, committed, memory_order_release);
+    current_log.position = committed;
+    if (atomic_load_explicit(&log_store.active, memory_order_acquire) && !save_cleared_at(committed)) {
+        printf("\nLogs cleared for now, but couldn't save '%s': they'll be back after a restart.\n", CLEARED_FILE);
+        return;
+    }
     printf("\nAll logs cleared.\n");
 }
 
+//Asks for a registered sensor type name, -1 if there's no such type
+int prompt_sensor_type() {
+    char name[SENSOR_NAME_LENGTH];
+    printf("Sensor type: ");
+    if (scanf("%19s", name) != 1) return -1;
+    int sensor_type = find_sensor_type(name);
+    if (sensor_type == -1) printf("\nUnknown sensor type '%s'.\n", name);
+    return sensor_type;
+}
+
+//Times are typed as seconds ago, easier than full dates at a gateway console
+uint64_t seconds_ago_to_ns(double seconds) {
+    uint64_t now = get_timestamp_ns();
+    uint64_t delta = seconds > 0 ? (uint64_t)(seconds * 1e9) : 0;
+    return delta > now ? 0 : now - delta;
+}
+
+void find_readings_in_range() {
+    int sensor_type = prompt_sensor_type();
+    if (sensor_type == -1) return;
+    double from_seconds, to_seconds;
+    printf("From how many seconds ago: ");
+    if (scanf("%lf", &from_seconds) != 1) return;
+    printf("To how many seconds ago: ");
+    if (scanf("%lf", &to_seconds) != 1) return;
+
+    log_entry_t entries[MAX_BUFFER_SIZE];
+    size_t found = query_sensor_range(sensor_type, seconds_ago_to_ns(from_seconds), seconds_ago_to_ns(to_seconds),
+                                      entries, MAX_BUFFER_SIZE);
+    printf("\n%zu %s reading(s) in range:\n", found, sensor_type_name(sensor_type));
+    for (size_t i = 0; i < found; i++) print_log_entry(entries[i].position, &entries[i].log);
+}
+
+void show_latest_readings() {
+    int sensor_type = prompt_sensor_type();
+    if (sensor_type == -1) return;
+    int wanted;
+    printf("How many: ");
+    if (scanf("%d", &wanted) != 1 || wanted <= 0) return;
+    if (wanted > MAX_BUFFER_SIZE) wanted = MAX_BUFFER_SIZE;
+
+    log_entry_t entries[MAX_BUFFER_SIZE];
+    size_t found = query_latest_readings(sensor_type, entries, wanted);
+    printf("\nLatest %zu %s reading(s):\n", found, sensor_type_name(sensor_type));
+    for (size_t i = 0; i < found; i++) print_log_entry(entries[i].position, &entries[i].log);
+}
+
+//Summary of one sensor's saved history in a range, plus the first few matches
+typedef struct {
+    uint16_t sensor_type;
+    uint64_t matches;
+    double sum;
+    float min, max;
+} history_summary_t;
+
+void summarize_history_record(uint64_t position, const sensor_log_t* log, void* context) {
+    history_summary_t* summary = (history_summary_t*)context;
+    if (log->sensor_type != summary->sensor_type) return;
+    if (summary->matches == 0 || log->value < summary->min) summary->min = log->value;
+    if (summary->matches == 0 || log->value > summary->max) summary->max = log->value;
+    summary->sum += log->value;
+    if (summary->matches < 10) print_log_entry(position, log);
+    summary->matches++;
+}
+
+void show_saved_history() {
+    if (!atomic_load_explicit(&log_store.active, memory_order_acquire)) {
+        printf("\nNo saved history, persistence is off.\n");
+        return;
+    }
+    int sensor_type = prompt_sensor_type();
+    if (sensor_type == -1) return;
+    double from_seconds, to_seconds;
+    printf("From how many seconds ago: ");
+    if (scanf("%lf", &from_seconds) != 1) return;
+    printf("To how many seconds ago: ");
+    if (scanf("%lf", &to_seconds) != 1) return;
+
+    history_summary_t summary = { (uint16_t)sensor_type, 0, 0, 0, 0 };
+    printf("\n");
+    uint64_t start = monotonic_ns();
+    uint64_t scanned = scan_saved_history(seconds_ago_to_ns(from_seconds), seconds_ago_to_ns(to_seconds),
+                                          summarize_history_record, &summary);
+    double elapsed_ms = (monotonic_ns() - start) / 1e6;
+    if (summary.matches > 10) printf("...\n");
+    printf("%llu %s reading(s) saved in range", (unsigned long long)summary.matches, sensor_type_name(sensor_type));
+    if (summary.matches > 0) {
+        printf(", mean %.2f min %.2f max %.2f", summary.sum / summary.matches, summary.min, summary.max);
+    }
+    printf(" (%llu records decoded in %.2f ms)\n", (unsigned long long)scanned, elapsed_ms);
+
+    //How well cold storage is doing
+    uint64_t cold_records = 0, cold_bytes = 0;
+    cold_block_header_t block;
+    uint64_t newest = atomic_load_explicit(&log_store.segment_no, memory_order_acquire);
+    for (uint64_t segment_no = 0; segment_no < newest; segment_no++) {
+        if (read_cold_header(segment_no, &block, NULL)) {
+            cold_records += block.count;
+            cold_bytes += sizeof(block) + block.payload_bytes;
+        }
+    }
+    if (cold_records > 0) {
+        printf("Cold storage: %llu records in %llu bytes, %.2f bytes/record (raw is %zu, %.1fx)\n",
+               (unsigned long long)cold_records, (unsigned long long)cold_bytes,
+               (double)cold_bytes / cold_records, sizeof(sensor_log_t),
+               (double)(cold_records * sizeof(sensor_log_t)) / cold_bytes);
+    }
+}
+
+void show_rolling_stats() {
+    int types = atomic_load_explicit(&sensor_registry.count, memory_order_acquire);
+    rolling_summary_t summary;
+    printf("\nRolling stats, last %d seconds per sensor:\n", AGGREGATE_WINDOW_SECONDS);
+    printf("%-20s %8s %10s %10s %10s %10s %10s\n", "Sensor", "Count", "Mean", "Min", "Max", "~p50", "~p99");
+    for (int i = 0; i < types; i++) {
+        int found = query_rolling_stats(i, &summary);
+        if (found == 0) continue;
+        if (found == -1) {
+            printf("%-20s (busy, try again)\n", sensor_type_name(i));
+            continue;
+        }
+        printf("%-20s %8llu %10.2f %10.2f %10.2f %10.2f %10.2f\n", sensor_type_name(i),
+               (unsigned long long)summary.count, summary.mean, summary.min, summary.max, summary.p50, summary.p99);
+    }
+}
+
+void show_rollups() {
+    int sensor_type = prompt_sensor_type();
+    if (sensor_type < 0) return;
+    double hours;
+    printf("How many hours back: ");
+    if (scanf("%lf", &hours) != 1 || hours <= 0) {
+        printf("Invalid duration.\n");
+        return;
+    }
+
+    rollup_summary_t summary;
+    uint64_t now = get_timestamp_ns();
+    uint64_t started = monotonic_ns();
+    if (!query_rollups(sensor_type, seconds_ago_to_ns(hours * 3600), now + 1, &summary)) {
+        printf("No %s readings in the last %g hours.\n", sensor_type_name(sensor_type), hours);
+        return;
+    }
+    printf("%s over the last %g hours: %llu readings, mean %.2f, min %.2f, max %.2f\n",
+           sensor_type_name(sensor_type), hours, (unsigned long long)summary.count,
+           summary.mean, summary.min, summary.max);
+    printf("(from %llu minute rows and %llu hour rows in %.1f us)\n",
+           (unsigned long long)summary.minute_rows, (unsigned long long)summary.hour_rows,
+           (monotonic_ns() - started) / 1e3);
+}
+
+void jump_to_time() {
+    double seconds;
+    printf("Jump to how many seconds ago: ");
+    if (scanf("%lf", &seconds) != 1) return;
+    uint64_t position = find_position_by_time(seconds_ago_to_ns(seconds));
+    uint64_t committed = atomic_load_explicit(&log_ring.committed, memory_order_acquire);
+    current_log.position = position < committed ? position : committed - 1;
+    display_current_log();
+}
+
+//Insert latency histogram, one per producer so recording never shares a cache line
+typedef struct {
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} latency_histogram_t;
+
+static inline uint32_t latency_bucket(uint64_t ns) {
+    if (ns < (2u << LATENCY_SUB_BUCKET_BITS)) return (uint32_t)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    return (uint32_t)((msb - LATENCY_SUB_BUCKET_BITS + 1) << LATENCY_SUB_BUCKET_BITS) +
+           (uint32_t)((ns >> (msb - LATENCY_SUB_BUCKET_BITS)) & ((1u << LATENCY_SUB_BUCKET_BITS) - 1));
+}
+
+//Middle of the range a bucket covers
+uint64_t latency_bucket_value(uint32_t bucket) {
+    if (bucket < (2u << LATENCY_SUB_BUCKET_BITS)) return bucket;
+    int shift = (int)(bucket >> LATENCY_SUB_BUCKET_BITS) - 1;
+    uint64_t low = (uint64_t)((1u << LATENCY_SUB_BUCKET_BITS) + (bucket & ((1u << LATENCY_SUB_BUCKET_BITS) - 1))) << shift;
+    return low + (1ull << shift) / 2;
+}
+
+static inline void record_latency(latency_histogram_t* histogram, uint64_t ns) {
+    histogram->counts[latency_bucket(ns)]++;
+    histogram->total++;
+    if (ns > histogram->max) histogram->max = ns;
+}
+
+void merge_latency(latency_histogram_t* into, const latency_histogram_t* from) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->total += from->total;
+    if (from->max > into->max) into->max = from->max;
+}
+
+uint64_t latency_percentile(const latency_histogram_t* histogram, double percentile) {
+    if (histogram->total == 0) return 0;
+    uint64_t rank = (uint64_t)(histogram->total * percentile / 100.0);
+    if (rank >= histogram->total) rank = histogram->total - 1;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen > rank) {
+            uint64_t value = latency_bucket_value(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+//How the live stream / load generator runs. The 'y' defaults are the old live stream:
+//one reading every 2 seconds, printed.
+typedef struct {
+    double rate;        //readings per second over all producers, 0 = as fast as possible
+    int producers;
+    int print_readings;
+} load_config_t;
+
+typedef struct {
+    uint64_t inserts;
+    latency_histogram_t latency;
+} producer_stats_t;
+
+typedef struct {
+    load_config_t config;
+    _Atomic int active;
+    int threads_started;
+    pthread_t threads[MAX_PRODUCERS];
+    producer_stats_t* stats;     //one per producer
+    uint64_t started_ns;
+} load_generator_t;
+
+static load_generator_t live_stream;
+
+//Sleeps until the monotonic deadline, in short slices so 'z' doesn't wait out a long interval
+static void sleep_until(uint64_t deadline_ns) {
+    for (;;) {
+        uint64_t now = monotonic_ns();
+        if (now >= deadline_ns || !atomic_load_explicit(&live_stream.active, memory_order_relaxed)) return;
+        uint64_t wait = deadline_ns - now;
+        if (wait > 100000000ull) wait = 100000000ull;
+        if (wait < 20000) {
+            sched_yield(); //too short to sleep accurately
+            continue;
+        }
+        struct timespec ts = { (time_t)(wait / 1000000000ull), (long)(wait % 1000000000ull) };
+        nanosleep(&ts, NULL);
+    }
+}
+
 void *live_stream_function(void *arg) {
-    (void)arg;
+    int producer = (int)(intptr_t)arg;
+    producer_stats_t* stats = &live_stream.stats[producer];
     const char *sensors[] = {"Temperature", "Humidity", "Pressure", "Vibration"};
-    while (live_stream_active) {
-        float value = 20.0 + (rand() % 300) / 10.0;
-        int sensor_index = rand() % 4;
-        add_sensor_log(sensors[sensor_index], value);
-        printf("[LIVE] New log added: %s = %.2f\n", sensors[sensor_index], value);
-        sleep(2);
+    int sensor_ids[4];
+    for (int i = 0; i < 4; i++) sensor_ids[i] = register_sensor_type(sensors[i]);
+
+    //rand() isn't per thread, a little xorshift is
+    uint32_t seed = (uint32_t)monotonic_ns() ^ (uint32_t)(producer * 2654435761u);
+    if (seed == 0) seed = 1;
+    uint64_t interval = live_stream.config.rate > 0
+                      ? (uint64_t)(1e9 * live_stream.config.producers / live_stream.config.rate) : 0;
+    uint64_t due = monotonic_ns();
+
+    while (atomic_load_explicit(&live_stream.active, memory_order_relaxed)) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        float value = 20.0 + (seed % 300) / 10.0;
+        int sensor_index = (seed >> 16) % 4;
+
+        uint64_t start = monotonic_ns();
+        add_sensor_log(sensor_ids[sensor_index], value);
+        record_latency(&stats->latency, monotonic_ns() - start);
+        stats->inserts++;
+
+        if (live_stream.config.print_readings) {
+            printf("[LIVE] New log added: %s = %.2f\n", sensors[sensor_index], value);
+        }
+        if (interval) {
+            due += interval;
+            sleep_until(due);
+        }
     }
     return NULL;
 }
 
+int start_load_generator(const load_config_t* config) {
+    if (atomic_load(&live_stream.active)) return 0;
+    live_stream.config = *config;
+    if (live_stream.config.producers < 1) live_stream.config.producers = 1;
+    if (live_stream.config.producers > MAX_PRODUCERS) live_stream.config.producers = MAX_PRODUCERS;
+    free(live_stream.stats);
+    live_stream.stats = (producer_stats_t*)calloc(live_stream.config.producers, sizeof(producer_stats_t));
+    if (!live_stream.stats) return 0;
+
+    atomic_store(&live_stream.active, 1);
+    live_stream.started_ns = monotonic_ns();
+    live_stream.threads_started = 0;
+    for (int i = 0; i < live_stream.config.producers; i++) {
+        if (pthread_create(&live_stream.threads[i], NULL, live_stream_function, (void*)(intptr_t)i) != 0) break;
+        live_stream.threads_started++;
+    }
+    return 1;
+}
+
+//Stops the producers and prints what they sustained
+void stop_load_generator(int report) {
+    if (!atomic_exchange(&live_stream.active, 0)) return;
+    for (int i = 0; i < live_stream.threads_started; i++) {
+        pthread_join(live_stream.threads[i], NULL);
+    }
+    if (!report) return;
+
+    double seconds = (monotonic_ns() - live_stream.started_ns) / 1e9;
+    static latency_histogram_t merged;
+    memset(&merged, 0, sizeof(merged));
+    for (int i = 0; i < live_stream.threads_started; i++) merge_latency(&merged, &live_stream.stats[i].latency);
+
+    printf("\nLoad report: %llu inserts from %d producer(s) in %.2f s = %.0f inserts/s",
+           (unsigned long long)merged.total, live_stream.threads_started, seconds, merged.total / seconds);
+    if (live_stream.config.rate > 0) printf(" (target %g/s)", live_stream.config.rate);
+    printf("\nInsert latency: p50 %llu ns, p99 %llu ns, p999 %llu ns, max %llu ns\n",
+           (unsigned long long)latency_percentile(&merged, 50),
+           (unsigned long long)latency_percentile(&merged, 99),
+           (unsigned long long)latency_percentile(&merged, 99.9),
+           (unsigned long long)merged.max);
+}
+
 void start_live_stream() {
-    if (!live_stream_active) {
-        live_stream_active = 1;
-        pthread_t thread;
-        pthread_create(&thread, NULL, live_stream_function, NULL);
-        pthread_detach(thread);
+    load_config_t config = { 0.5, 1, 1 };
+    if (start_load_generator(&config)) {
         printf("\nLive streaming started. Press 'z' to pause.\n");
     } else {
         printf("\nLive mode already active.\n");
     }
 }
 
+//'g': same stream, but as fast/wide as asked and quiet unless told otherwise
+void start_load_generation() {
+    load_config_t config;
+    printf("Readings per second (0 = unthrottled): ");
+    if (scanf("%lf", &config.rate) != 1) return;
+    printf("Producer threads (1-%d): ", MAX_PRODUCERS);
+    if (scanf("%d", &config.producers) != 1) return;
+    printf("Print every reading (0/1): ");
+    if (scanf("%d", &config.print_readings) != 1) return;
+    if (start_load_generator(&config)) {
+        printf("\nLoad generation started. Press 'z' to stop and see the report.\n");
+    } else {
+        printf("\nLive mode already active.\n");
+    }
+}
+
 void stop_live_stream() {
-    live_stream_active = 0;
+    stop_load_generator(1);
     printf("\nLive streaming paused.\n");
 }
 
-int main() {
+//--load: headless run for sizing gateways
+int run_load_mode(const load_config_t* config, double duration_seconds) {
+    printf("Generating load for %.1f s: %s, %d producer(s)\n", duration_seconds,
+           config->rate > 0 ? "rate limited" : "unthrottled", config->producers);
+    if (!start_load_generator(config)) return 1;
+    usleep((useconds_t)(duration_seconds * 1e6));
+    stop_load_generator(1);
+    return 0;
+}
+
+//Ingest benchmark: records/sec for single vs batch appends as batch size and producers grow
+#define BENCH_RECORDS 2000000
+
+typedef struct {
+    size_t records;
+    size_t batch_size;
+    uint16_t sensor_type;
+} bench_producer_t;
+
+void *bench_producer_function(void *arg) {
+    bench_producer_t *job = (bench_producer_t*)arg;
+    sensor_reading_t readings[MAX_BUFFER_SIZE];
+    for (size_t i = 0; i < job->batch_size; i++) {
+        readings[i].sensor_type = job->sensor_type;
+        readings[i].value = (float)i;
+    }
+
+    size_t done = 0;
+    if (job->batch_size == 1) {
+        while (done < job->records) {
+            add_sensor_log(job->sensor_type, (float)done);
+            done++;
+        }
+    } else {
+        while (done < job->records) {
+            size_t count = job->records - done < job->batch_size ? job->records - done : job->batch_size;
+            add_sensor_log_batch(readings, count);
+            done += count;
+        }
+    }
+    return NULL;
+}
+
+double bench_ingest_rate(int threads, size_t batch_size, uint16_t sensor_type) {
+    pthread_t workers[16];
+    bench_producer_t jobs[16];
+
+    uint64_t start = monotonic_ns();
+    for (int t = 0; t < threads; t++) {
+        jobs[t].records = BENCH_RECORDS / threads;
+        jobs[t].batch_size = batch_size;
+        jobs[t].sensor_type = sensor_type;
+        pthread_create(&workers[t], NULL, bench_producer_function, &jobs[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    uint64_t elapsed = monotonic_ns() - start;
+    return (double)(BENCH_RECORDS / threads * threads) * 1e9 / (double)elapsed;
+}
+
+int run_ingest_benchmark() {
+    const int thread_counts[] = {1, 2, 4, 8};
+    const size_t batch_sizes[] = {1, 4, 16, MAX_BUFFER_SIZE};
+    uint16_t sensor_type = register_sensor_type("Benchmark");
+
+    printf("Ingest benchmark, %d records per run, ring of %llu slots\n", BENCH_RECORDS, (unsigned long long)log_ring.capacity);
+    printf("%-10s", "threads");
+    for (int b = 0; b < 4; b++) printf("  batch=%-8zu", batch_sizes[b]);
+    printf("\n");
+    for (int t = 0; t < 4; t++) {
+        printf("%-10d", thread_counts[t]);
+        for (int b = 0; b < 4; b++) {
+            printf("  %10.0f r/s", bench_ingest_rate(thread_counts[t], batch_sizes[b], sensor_type));
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+//Contention benchmark: one writer flat out, a growing crowd of readers browsing the ring.
+//Readers never take a lock, so the writer's rate should only drop by the CPU they use.
+#define CONTENTION_RUN_MS 1000
+
+typedef struct {
+    _Atomic int* stop;
+    uint64_t operations;
+    uint16_t sensor_type;
+} contention_job_t;
+
+void *contention_writer_function(void *arg) {
+    contention_job_t *job = (contention_job_t*)arg;
+    while (!atomic_load_explicit(job->stop, memory_order_relaxed)) {
+        add_sensor_log(job->sensor_type, (float)job->operations);
+        job->operations++;
+    }
+    return NULL;
+}
+
+//Mix of what an operator does: walk back and forth, and grab a snapshot of the newest logs
+void *contention_reader_function(void *arg) {
+    contention_job_t *job = (contention_job_t*)arg;
+    log_cursor_t cursor = { 0 };
+    log_entry_t snapshot[8];
+    sensor_log_t log;
+    int direction = 1;
+    while (!atomic_load_explicit(job->stop, memory_order_relaxed)) {
+        if (!cursor_step(&cursor, direction, &log)) direction = -direction;
+        if ((job->operations & 15) == 0) take_log_snapshot(snapshot, 8);
+        job->operations++;
+    }
+    return NULL;
+}
+
+int run_contention_benchmark() {
+    const int reader_counts[] = {0, 1, 2, 4, 8};
+    uint16_t sensor_type = register_sensor_type("Benchmark");
+
+    printf("Reader contention benchmark, 1 writer, %d ms per run\n", CONTENTION_RUN_MS);
+    printf("%-10s %18s %18s\n", "readers", "writer logs/s", "reader steps/s");
+    for (int r = 0; r < 5; r++) {
+        _Atomic int stop = 0;
+        pthread_t writer, readers[8];
+        contention_job_t writer_job = { &stop, 0, sensor_type };
+        contention_job_t reader_jobs[8];
+
+        pthread_create(&writer, NULL, contention_writer_function, &writer_job);
+        for (int i = 0; i < reader_counts[r]; i++) {
+            reader_jobs[i] = (contention_job_t){ &stop, 0, sensor_type };
+            pthread_create(&readers[i], NULL, contention_reader_function, &reader_jobs[i]);
+        }
+        usleep(CONTENTION_RUN_MS * 1000);
+        atomic_store(&stop, 1);
+        pthread_join(writer, NULL);
+        uint64_t reads = 0;
+        for (int i = 0; i < reader_counts[r]; i++) {
+            pthread_join(readers[i], NULL);
+            reads += reader_jobs[i].operations;
+        }
+        printf("%-10d %18.0f %18.0f\n", reader_counts[r],
+               writer_job.operations * 1000.0 / CONTENTION_RUN_MS, reads * 1000.0 / CONTENTION_RUN_MS);
+    }
+    return 0;
+}
+
+//Binary frame as it goes over the wire: magic, zero padded type name, little endian float
+typedef struct {
+    uint8_t magic[2];
+    char sensor_type[SENSOR_NAME_LENGTH];
+    uint8_t reserved[2];
+    float value;
+} __attribute__((packed)) sensor_frame_t;
+
+_Static_assert(sizeof(sensor_frame_t) == 28, "sensor frames are 28 bytes on the wire");
+
+#ifdef __linux__
+//One per connection (or the pipe). Partial frames wait in the buffer for the next read.
+typedef struct {
+    int fd;
+    int new_types; //sensor types this connection added to the registry
+    size_t used;
+    char buffer[DAEMON_BUFFER_SIZE];
+} daemon_client_t;
+
+typedef struct {
+    sensor_reading_t batch[MAX_BUFFER_SIZE];
+    size_t batched;
+    uint64_t frames;
+    uint64_t bad_frames;
+} daemon_ingest_t;
+
+static volatile sig_atomic_t daemon_stop = 0;
+
+void handle_daemon_signal(int signal_number) {
+    (void)signal_number;
+    daemon_stop = 1;
+}
+
+static void daemon_flush(daemon_ingest_t* ingest) {
+    if (ingest->batched == 0) return;
+    add_sensor_log_batch(ingest->batch, ingest->batched);
+    ingest->batched = 0;
+}
+
+//Known types always go through. Unknown ones are registered (and saved for good) only
+//up to DAEMON_NEW_TYPES_PER_CLIENT per connection, past that they count as bad frames.
+static void daemon_add_reading(daemon_client_t* client, daemon_ingest_t* ingest, const char* sensor_type, float value) {
+    int id = find_sensor_type(sensor_type);
+    if (id == -1 && client->new_types < DAEMON_NEW_TYPES_PER_CLIENT) {
+        id = register_sensor_type(sensor_type);
+        if (id != -1) client->new_types++;
+    }
+    if (id == -1) {
+        ingest->bad_frames++;
+        return;
+    }
+    ingest->batch[ingest->batched].sensor_type = (uint16_t)id;
+    ingest->batch[ingest->batched].value = value;
+    ingest->frames++;
+    if (++ingest->batched == MAX_BUFFER_SIZE) daemon_flush(ingest);
+}
+
+//Takes every complete frame out of the client's buffer, keeps the partial tail
+static void daemon_parse_frames(daemon_client_t* client, daemon_ingest_t* ingest) {
+    size_t offset = 0;
+    while (offset < client->used) {
+        char* frame = client->buffer + offset;
+        size_t left = client->used - offset;
+
+        if ((uint8_t)frame[0] == FRAME_MAGIC_0) {
+            if (left < sizeof(sensor_frame_t)) break;
+            sensor_frame_t binary;
+            memcpy(&binary, frame, sizeof(binary));
+            if (binary.magic[1] != FRAME_MAGIC_1) {
+                //Lost sync, skip a byte and look again
+                ingest->bad_frames++;
+                offset++;
+                continue;
+            }
+            binary.sensor_type[SENSOR_NAME_LENGTH - 1] = '\0';
+            daemon_add_reading(client, ingest, binary.sensor_type, binary.value);
+            offset += sizeof(sensor_frame_t);
+            continue;
+        }
+
+        char* newline = memchr(frame, '\n', left);
+        if (!newline) {
+            //A line that can never end in our buffer is garbage
+            if (left == DAEMON_BUFFER_SIZE) {
+                ingest->bad_frames++;
+                offset = client->used;
+            }
+            break;
+        }
+        *newline = '\0';
+        char name[SENSOR_NAME_LENGTH];
+        float value;
+        if (sscanf(frame, " %19[^, \t]%*[, \t]%f", name, &value) == 2) {
+            daemon_add_reading(client, ingest, name, value);
+        } else if (newline != frame && !(newline == frame + 1 && frame[0] == '\r')) {
+            ingest->bad_frames++;
+        }
+        offset = (size_t)(newline - client->buffer) + 1;
+    }
+    memmove(client->buffer, client->buffer + offset, client->used - offset);
+    client->used -= offset;
+}
+
+//Returns 0 once the client is gone (EOF or error)
+static int daemon_read_client(daemon_client_t* client, daemon_ingest_t* ingest) {
+    for (;;) {
+        ssize_t got = read(client->fd, client->buffer + client->used, DAEMON_BUFFER_SIZE - client->used);
+        if (got > 0) {
+            client->used += (size_t)got;
+            daemon_parse_frames(client, ingest);
+            continue;
+        }
+        if (got == 0) return 0;
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+static daemon_client_t* daemon_watch(int epoll_fd, int fd) {
+    daemon_client_t* client = (daemon_client_t*)malloc(sizeof(daemon_client_t));
+    if (!client) return NULL;
+    client->fd = fd;
+    client->new_types = 0;
+    client->used = 0;
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = client };
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        free(client);
+        return NULL;
+    }
+    return client;
+}
+
+static void daemon_drop(int epoll_fd, daemon_client_t* client) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    free(client);
+}
+
+//Headless ingestion. path is a FIFO to read, "-" for stdin (stops at EOF, for replays),
+//or anything else becomes a UNIX stream socket any number of feeds can connect to.
+//Each wakeup parses everything readable and hands it to the ring in batches.
+int run_daemon_mode(const char* path) {
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        printf("Error: epoll_create1 failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    int listen_fd = -1;
+    int stop_at_eof = 0;
+    struct stat st;
+    daemon_client_t listener = { .fd = -1 };
+
+    if (strcmp(path, "-") == 0) {
+        stop_at_eof = 1;
+        if (!daemon_watch(epoll_fd, STDIN_FILENO)) {
+            printf("Error: can't watch stdin (a regular file? use a pipe)\n");
+            close(epoll_fd);
+            return 1;
+        }
+    } else if (stat(path, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        //Opened read-write so we never see EOF when a writer goes away
+        int fd = open(path, O_RDWR | O_NONBLOCK);
+        if (fd == -1 || !daemon_watch(epoll_fd, fd)) {
+            printf("Error: can't open FIFO '%s'\n", path);
+            if (fd != -1) close(fd);
+            close(epoll_fd);
+            return 1;
+        }
+    } else {
+        struct sockaddr_un address = { .sun_family = AF_UNIX };
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            printf("Error: socket path too long\n");
+            close(epoll_fd);
+            return 1;
+        }
+        strcpy(address.sun_path, path);
+        unlink(path);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (listen_fd == -1 || bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) == -1 ||
+            listen(listen_fd, 64) == -1) {
+            printf("Error: can't listen on '%s': %s\n", path, strerror(errno));
+            if (listen_fd != -1) close(listen_fd);
+            unlink(path);
+            close(epoll_fd);
+            return 1;
+        }
+        listener.fd = listen_fd;
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = &listener };
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) == -1) {
+            printf("Error: can't watch '%s': %s\n", path, strerror(errno));
+            close(listen_fd);
+            unlink(path);
+            close(epoll_fd);
+            return 1;
+        }
+    }
+
+    struct sigaction action = { .sa_handler = handle_daemon_signal };
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Daemon ingesting from '%s'. Ctrl+C to stop.\n", path);
+    fflush(stdout);
+
+    daemon_ingest_t ingest = {0};
+    struct epoll_event events[DAEMON_MAX_EVENTS];
+    uint64_t started = monotonic_ns();
+    uint64_t last_report = started, frames_at_report = 0;
+
+    while (!daemon_stop) {
+        int ready = epoll_wait(epoll_fd, events, DAEMON_MAX_EVENTS, 1000);
+        for (int i = 0; i < ready; i++) {
+            daemon_client_t* client = (daemon_client_t*)events[i].data.ptr;
+            if (client == &listener) {
+                int fd;
+                while ((fd = accept(listen_fd, NULL, NULL)) != -1) {
+                    if (!daemon_watch(epoll_fd, fd)) close(fd);
+                }
+                continue;
+            }
+            if (!daemon_read_client(client, &ingest)) {
+                daemon_drop(epoll_fd, client);
+                if (stop_at_eof) daemon_stop = 1;
+            }
+        }
+        //Whatever is left over is published at the end of every wakeup, never held back
+        daemon_flush(&ingest);
+
+        uint64_t now = monotonic_ns();
+        if (now - last_report >= DAEMON_REPORT_SECONDS * 1000000000ull) {
+            printf("[DAEMON] %llu frames (%.0f/s last %d s), %llu bad\n",
+                   (unsigned long long)ingest.frames,
+                   (ingest.frames - frames_at_report) * 1e9 / (now - last_report), DAEMON_REPORT_SECONDS,
+                   (unsigned long long)ingest.bad_frames);
+            fflush(stdout);
+            last_report = now;
+            frames_at_report = ingest.frames;
+        }
+    }
+
+    daemon_flush(&ingest);
+    double seconds = (monotonic_ns() - started) / 1e9;
+    printf("\nDaemon stopped: %llu frames in %.1f s (%.0f/s), %llu bad\n",
+           (unsigned long long)ingest.frames, seconds, ingest.frames / seconds,
+           (unsigned long long)ingest.bad_frames);
+    if (listen_fd != -1) {
+        close(listen_fd);
+        unlink(path);
+    }
+    close(epoll_fd);
+    return 0;
+}
+#else
+int run_daemon_mode(const char* path) {
+    (void)path;
+    printf("Error: daemon mode needs epoll (Linux).\n");
+    return 1;
+}
+#endif
+
+void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --bench-ingest        single vs batch ingest benchmark\n");
+    printf("  --bench-readers       writer vs readers contention benchmark\n");
+    printf("  --load                headless load generation, then report\n");
+    printf("    --rate N            readings per second, 0 = unthrottled (default 0)\n");
+    printf("    --producers N       producer threads (default 1)\n");
+    printf("    --duration S        seconds to run (default 5)\n");
+    printf("  --daemon PATH         headless ingestion from a UNIX socket, FIFO or - (stdin)\n");
+    printf("                        frames: \"Type,value\\n\" lines or 28 byte binary frames\n");
+    printf("  --no-persist          don't open the on-disk segments\n");
+    printf("Retention:\n");
+    printf("  --ring-slots N        raw records kept in memory, rounded up to a power of two (default %d)\n", MAX_BUFFER_SIZE);
+    printf("  --raw-minutes M       also drop raw records older than M minutes, 0 = no limit (default 0)\n");
+    printf("  --minute-rows R       1 minute rollups kept per sensor (default %d)\n", DEFAULT_MINUTE_ROWS);
+    printf("  --hour-rows H         1 hour rollups kept per sensor (default %d)\n", DEFAULT_HOUR_ROWS);
+}
+
+int main(int argc, char *argv[]) {
+    int persist = 1;
+    int load_mode = 0;
+    int (*benchmark)(void) = NULL;
+    const char* daemon_path = NULL;
+    double load_duration = 5;
+    load_config_t load_config = { 0, 1, 0 };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench-ingest") == 0) benchmark = run_ingest_benchmark;
+        else if (strcmp(argv[i], "--bench-readers") == 0) benchmark = run_contention_benchmark;
+        else if (strcmp(argv[i], "--load") == 0) load_mode = 1;
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) load_config.rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--producers") == 0 && i + 1 < argc) load_config.producers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) load_duration = atof(argv[++i]);
+        else if (strcmp(argv[i], "--daemon") == 0 && i + 1 < argc) daemon_path = argv[++i];
+        else if (strcmp(argv[i], "--no-persist") == 0) persist = 0;
+        else if (strcmp(argv[i], "--ring-slots") == 0 && i + 1 < argc) retention.ring_slots = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--raw-minutes") == 0 && i + 1 < argc) retention.raw_minutes = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--minute-rows") == 0 && i + 1 < argc) retention.minute_rows = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--hour-rows") == 0 && i + 1 < argc) retention.hour_rows = strtoull(argv[++i], NULL, 10);
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (retention.minute_rows == 0) retention.minute_rows = 1;
+    if (retention.hour_rows == 0) retention.hour_rows = 1;
+    if (!init_log_ring(retention.ring_slots)) {
+        printf("Error: couldn't allocate a ring of %llu slots.\n", (unsigned long long)retention.ring_slots);
+        return 1;
+    }
+    if (benchmark) {
+        start_ring_consumer();
+        int result = benchmark();
+        stop_ring_consumer();
+        return result;
+    }
+
     srand(time(NULL));
     char command;
+
+    uint64_t recovery_start = monotonic_ns();
+    if (persist && open_log_store()) {
+        printf("Recovered %llu saved logs from %llu segments in %.2f ms\n",
+               (unsigned long long)atomic_load(&log_ring.committed),
+               (unsigned long long)log_store.recovered_segments,
+               (monotonic_ns() - recovery_start) / 1e6);
+    }
+    start_ring_consumer();
+
+    if (load_mode || daemon_path) {
+        int result = daemon_path ? run_daemon_mode(daemon_path) : run_load_mode(&load_config, load_duration);
+        stop_ring_consumer();
+        close_log_store();
+        return result;
+    }
     
     printf("!!!!! IoT Gateway Log System !!!!!\n");
     printf("Commands:\n");
     printf("  n -Next log\n");
     printf("  p -Previous log\n");
     printf("  y -Start live streaming\n");
-    printf("  z -Pause live streaming\n");
+    printf("  g -Start load generation (rate, producers, quiet)\n");
+    printf("  z -Pause live streaming / stop load and report\n");
+    printf("  f -Find readings of a sensor in a time range\n");
+    printf("  l -Latest readings of a sensor\n");
+    printf("  j -Jump to a time\n");
+    printf("  a -Rolling stats per sensor\n");
+    printf("  r -Long range stats of a sensor (rollups)\n");
+    printf("  h -Search saved history of a sensor\n");
     printf("  c -Clear all logs\n");
     printf("  s -Save and exit\n");
     printf("==============================\n");
     
-    add_sensor_log("Temperature", 25.5);
-    add_sensor_log("Humidity", 60.2);
-    add_sensor_log("Pressure", 1013.25);
+    //Seed readings only on a fresh store, otherwise we already have history
+    if (atomic_load(&log_ring.committed) == 0) {
+        add_sensor_log(register_sensor_type("Temperature"), 25.5);
+        add_sensor_log(register_sensor_type("Humidity"), 60.2);
+        add_sensor_log(register_sensor_type("Pressure"), 1013.25);
+    }
     
-    current_log = head;
+    current_log.position = oldest_log_position(atomic_load(&log_ring.committed));
     display_current_log();
     
     while (system_running) {
         printf("\nEnter command: ");
         scanf(" %c", &command);
+        wait_for_ring_consumer();
         
         switch (command) {
             case 'n': navigate_next(); break;
             case 'p': navigate_previous(); break;
             case 'y': start_live_stream(); break;
+            case 'g': start_load_generation(); break;
             case 'z': stop_live_stream(); break;
+            case 'f': find_readings_in_range(); break;
+            case 'l': show_latest_readings(); break;
+            case 'j': jump_to_time(); break;
+            case 'a': show_rolling_stats(); break;
+            case 'r': show_rollups(); break;
+            case 'h': show_saved_history(); break;
             case 'c': clear_all_logs(); break;
             case 's': 
                 printf("\nSaving session and exiting...\n");
@@ -194,7 +2653,9 @@ int main() {
         }
     }
     
-    clear_all_logs();
+    stop_load_generator(0);
+    stop_ring_consumer();
+    close_log_store();
     printf("System terminated.\n");
     return 0;
 }
\ No newline at end of file
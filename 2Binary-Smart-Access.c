@@ -2,81 +2,634 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
 
-#define MAX_NAMES 40
 #define MAX_NAME_LENGTH 50
 #define UNKNOWN_NAMES_FILE "unknown_names.log"
+#define MAX_LOAD_THREADS 16
+#define MIN_CHUNK_BYTES (1 << 20) //smaller files aren't worth a thread each
+#define SORT_RADIX 65536
+#define MAX_SUGGESTION_DISTANCE 3
+#define NODE_NONE UINT32_MAX //no DAWG node
+#define SCORE_LANES 32 //names per scoring block, one AVX2 register of bytes
+#define BENCH_PAIRS 3200000 //distance calls per benchmarked variant
+#define BATCH_ROUND 65536 //attempts read, checked and written at a time in batch mode
+#define BATCH_GRAIN 64 //attempts a batch worker claims at once
+#define MAX_BATCH_THREADS 64
+#define ROSTER_MAGIC "ROSTIDX1"
+#define ROSTER_VERSION 3
+#define ROSTER_BYTE_ORDER 0x01020304u
+#define ROSTER_SECTIONS 5
+#define ROSTER_ALIGN 64 //every array starts on its own cache line
+#define MAX_INDEX_READERS 16 //pins of the live roster held at once, more wait for one to end
+#define RELOAD_SETTLE_MS 100 //quiet time after the last change before reloading
+#define AUDIT_FLUSH_MS 1000 //longest a denied name waits in memory
+#define AUDIT_FSYNC_SECONDS 5
+#define AUDIT_TABLE_SLOTS 4096 //power of two, kept at most half full
+#define AUDIT_MAX_PENDING (AUDIT_TABLE_SLOTS / 2)
+#define AUDIT_BUFFER_BYTES (64 * 1024)
 
-//BST node struc
-typedef struct TreeNode {
+//The roster as a minimal DAWG: the trie of all names with identical suffix subtrees merged,
+//built straight from the sorted names. A node's edges are consecutive and sorted by label,
+//so a depth first walk meets the names in strcmp order. Exact lookups and close typos walk
+//it, and it is the only place the names are kept spelled out by character.
+typedef struct {
+    uint32_t count;
+    uint32_t* dawgFirstEdge;  //node n's edges are dawgFirstEdge[n] .. dawgFirstEdge[n + 1]
+    uint8_t* dawgFinal;       //a name ends at this node
+    uint8_t* dawgLabel;
+    uint32_t* dawgTarget;
+    uint32_t dawgNodes;
+    uint32_t dawgEdges;
+    uint32_t dawgRoot;
+    //Wider typos score the names bucketed by length into blocks of SCORE_LANES and transposed:
+    //byte j of every name in a block sits together, so one vector compare checks a query
+    //character against character j of SCORE_LANES names at once. Lanes are read back into
+    //names directly; padding lanes are all zero, and no name starts with a NUL.
+    uint8_t* blockChars;      //blocks of length L start at lengthBytes[L], L * SCORE_LANES bytes each
+    uint32_t lengthBlocks[MAX_NAME_LENGTH + 1]; //blocks of length L are lengthBlocks[L]..lengthBlocks[L + 1]
+    size_t lengthBytes[MAX_NAME_LENGTH];
+    void* mapping;            //compiled roster the arrays point into, NULL when they're malloc'd
+    size_t mappingSize;
+} NameIndex;
+
+//The names spelled out, only made on demand for showing the roster and for the distance
+//benchmark. Balanced BST with no pointers: names are sorted, deduplicated and laid out in
+//Eytzinger (breadth first) order, the root is slot 0 and the children of slot k are 2k+1
+//and 2k+2, so it is perfectly balanced however the file was sorted.
+typedef struct {
+    char* names;        //every name back to back, NUL terminated, in slot order
+    uint32_t* offsets;  //offsets[k] is where slot k's name starts in names
+    uint32_t count;
+} NameList;
+
+//Start of a compiled roster file, followed by the NameIndex arrays at sectionOffset.
+//Everything is counts and offsets, nothing is a pointer, so the file can be mapped
+//anywhere and used as it is. Replace one only by renaming a complete file over it, as
+//compileRoster does: the mapping stays on the old inode, while a file rewritten or
+//truncated in place changes under running lookups (or SIGBUSes them).
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;       //ROSTER_BYTE_ORDER as the compiler wrote it
+    uint32_t maxNameLength;   //MAX_NAME_LENGTH and SCORE_LANES shape the block layout
+    uint32_t scoreLanes;
+    uint32_t count;
+    uint32_t dawgNodes;
+    uint32_t dawgEdges;
+    uint32_t dawgRoot;
+    uint32_t lengthBlocks[MAX_NAME_LENGTH + 1];
+    uint32_t reserved;
+    uint64_t lengthBytes[MAX_NAME_LENGTH];
+    uint64_t sectionOffset[ROSTER_SECTIONS];
+    uint64_t sectionBytes[ROSTER_SECTIONS];
+    uint64_t fileSize;
+} RosterFileHeader;
+
+//DAWG construction state (Daciuk et al., sorted input): the nodes along the last name
+//added are still open, everything else is frozen. Freezing looks the node up in a
+//register of frozen nodes first and reuses an identical one if there is one.
+typedef struct {
+    uint8_t labels[MAX_NAME_LENGTH][256];
+    uint32_t targets[MAX_NAME_LENGTH][256];
+    uint16_t edgeCount[MAX_NAME_LENGTH];
+    uint8_t final[MAX_NAME_LENGTH];
+    uint32_t* table;          //node id + 1, 0 for empty
+    size_t tableSize;         //power of two
+    uint32_t nodeCapacity;
+    uint32_t edgeCapacity;
+} DawgBuilder;
+
+//Bounded edit distance from one query to a whole block of same length names.
+//Lanes come back as maxDistance + 1 once they can't make it.
+typedef void (*BlockScorer)(const char* query, int queryLength, const uint8_t* block, int length,
+                            int maxDistance, uint8_t* distances);
+
+//One loader thread's share of the roster file: whole lines starting in [start, end)
+typedef struct {
+    char* data;
+    size_t size;
+    size_t start;
+    size_t end;
+    char** names;       //sorted and deduplicated once the thread is done
+    size_t count;
+    size_t capacity;
+    size_t lines;       //names read, duplicates included
+} LoadChunk;
+
+//A name and its first 8 bytes as a big endian number, so comparing prefixes
+//orders names exactly like strcmp does up to that point
+typedef struct {
+    uint64_t prefix;
+    char* name;
+} SortKey;
+
+//Two sorted runs merged into one, dropping names both have
+typedef struct {
+    LoadChunk* left;
+    LoadChunk* right;
+    char** merged;
+    size_t count;
+} MergeJob;
+
+//An unknown name waiting for the audit writer. Repeats within one flush only bump the
+//count and the last seen time, so a burst of the same name ends up as a single line.
+typedef struct {
     char name[MAX_NAME_LENGTH];
-    struct TreeNode* left;
-    struct TreeNode* right;
-} TreeNode;
+    uint32_t count;           //0 for an empty slot
+    time_t firstSeen;
+    time_t lastSeen;
+} AuditEntry;
+
+//Open addressed on the name, plus the order names first showed up in so the log
+//stays chronological
+typedef struct {
+    AuditEntry slots[AUDIT_TABLE_SLOTS];
+    uint32_t order[AUDIT_MAX_PENDING];
+    uint32_t used;
+} AuditBatch;
+
+//Background audit writer. A denied request only drops its name into the active batch
+//under the lock; the writer thread swaps batches every AUDIT_FLUSH_MS (sooner if one
+//fills up), turns the full one into a few large appends and fsyncs every
+//AUDIT_FSYNC_SECONDS. Nothing on the request path touches the disk.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;      //writer: a batch filled up or we're stopping
+    pthread_cond_t drained;   //requests: the full batch has been swapped out
+    AuditBatch batches[2];
+    int active;
+    int running;
+    int stopping;
+    int fd;
+    pthread_t thread;
+} AuditLog;
+
+enum { ACCESS_GRANTED, ACCESS_SUGGESTED, ACCESS_DENIED, ACCESS_INVALID };
+
+//One access attempt in batch mode and what came of it
+typedef struct {
+    char name[MAX_NAME_LENGTH];
+    char suggestion[MAX_NAME_LENGTH];
+    uint8_t outcome;
+    uint8_t distance;
+    uint32_t latencyNs;
+} AccessAttempt;
+
+//The batch workers, started once and handed one round of attempts after another. They
+//claim BATCH_GRAIN attempts at a time off next, so slow suggestions don't leave the
+//other threads idle.
+typedef struct {
+    const NameIndex* index;
+    AccessAttempt* attempts;
+    size_t count;
+    atomic_size_t next;
+    pthread_mutex_t lock;
+    pthread_cond_t posted;    //a new round, or stopping
+    pthread_cond_t finished;  //the last worker left the round
+    uint64_t round;           //rounds posted so far
+    int busy;                 //workers still in the current round
+    int stopping;
+} BatchPool;
+
+//Every latency seen for one outcome, sorted at the end for the percentiles
+typedef struct {
+    uint32_t* ns;
+    size_t count;
+    size_t capacity;
+} LatencyLog;
+
+//A roster snapshot replaced by a reload, kept until no reader can still be using it
+typedef struct RetiredIndex {
+    NameIndex* index;
+    uint64_t epoch;           //global epoch when it was swapped out
+    struct RetiredIndex* next;
+} RetiredIndex;
 
 //Function declarations ofc
-TreeNode* createNode(const char* name);
-TreeNode* insertBST(TreeNode* root, const char* name);
-TreeNode* searchBST(TreeNode* root, const char* name);
-void freeBST(TreeNode* root);
+size_t sortUniqueNames(char** names, size_t count);
+NameIndex* buildNameIndex(char** sorted, uint32_t count);
+int buildScoringBlocks(NameIndex* index, char** sorted, uint32_t count);
+int buildDawg(NameIndex* index, char** sorted, uint32_t count);
+int dawgContains(const NameIndex* index, const char* name);
+uint32_t dawgClosestMatch(const NameIndex* index, const char* input, char* bestMatch, int* bestDistance);
+const char* selectBlockScorer(const char* forced);
+uint32_t blockClosestMatch(const NameIndex* index, const char* input, char* bestMatch, int* bestDistance);
+NameList* listNames(const NameIndex* index);
+void freeNameList(NameList* list);
+const char* indexName(const NameList* list, uint32_t slot);
+const char* searchNames(const NameList* list, const char* name);
+void freeNameIndex(NameIndex* index);
+int levenshteinDistanceMatrix(const char* s1, const char* s2);
+int boundedLevenshtein(const char* s1, const char* s2, int maxDistance);
 int levenshteinDistance(const char* s1, const char* s2);
-void findClosestMatch(TreeNode* root, const char* input, char* bestMatch, int* bestDistance);
+void scanClosestMatch(const NameList* list, const char* input, char* bestMatch, int* bestDistance);
+uint32_t findClosestMatch(const NameIndex* index, const char* input, char* bestMatch, int* bestDistance);
+int startAuditLog(const char* path);
 void logUnknownName(const char* name);
-TreeNode* loadNamesFromFile(const char* filename);
+void stopAuditLog(void);
+NameIndex* loadNamesFromFile(const char* filename);
+int compileRoster(const char* namesFile, const char* indexFile);
+NameIndex* mapRosterFile(int fd, size_t size);
+int verifyRoster(const char* indexFile);
 void displayMenu();
-void processAccessRequest(TreeNode* root);
-void printTree(TreeNode* root, int space);
+int checkAccess(const NameIndex* index, const char* name, char* suggestion, int* distance);
+void processAccessRequest(void);
+void printTree(const NameList* list, uint32_t slot, int space);
+int runDistanceBenchmark(const char* filename);
+int runBatchCheck(const char* namesFile, const char* attemptsFile, long threads);
+const NameIndex* pinIndex(void);
+void unpinIndex(void);
+int startRosterWatcher(const char* filename, NameIndex* initial);
+void stopRosterWatcher(void);
 
 
 
-TreeNode* createNode(const char* name) {
-    TreeNode* newNode = (TreeNode*)malloc(sizeof(TreeNode));
-    if (newNode != NULL) {
-        strncpy(newNode->name, name, MAX_NAME_LENGTH - 1);
-        newNode->name[MAX_NAME_LENGTH - 1] = '\0';
-        newNode->left = newNode->right = NULL;
+static uint64_t namePrefix(const char* name) {
+    uint64_t prefix = 0;
+    for (int i = 0; i < 8; i++) {
+        prefix = (prefix << 8) | (unsigned char)*name;
+        if (*name) name++;
     }
-    return newNode;
+    return prefix;
+}
+
+//In order walk of the implicit tree hands out the sorted names one by one.
+//Recursion depth is the tree height, so ~24 for 10M names.
+static uint32_t fillSlots(char** sorted, uint32_t next, uint32_t slot, uint32_t count, const char** slots) {
+    if (slot >= count) return next;
+    next = fillSlots(sorted, next, 2 * slot + 1, count, slots);
+    slots[slot] = sorted[next++];
+    return fillSlots(sorted, next, 2 * slot + 2, count, slots);
 }
 
-//Inserting name into BST (sensitiveee)
-TreeNode* insertBST(TreeNode* root, const char* name) {
-    if (root == NULL) {
-        return createNode(name);
+//Prefix order first, strcmp only when all 8 bytes tie and neither name ends inside them
+static int compareKeys(const void* a, const void* b) {
+    const SortKey* x = (const SortKey*)a;
+    const SortKey* y = (const SortKey*)b;
+    if (x->prefix != y->prefix) return x->prefix < y->prefix ? -1 : 1;
+    return (x->prefix & 0xFF) ? strcmp(x->name + 8, y->name + 8) : 0;
+}
+
+//Sorts names in place and drops duplicates, returns how many are left.
+//LSD radix sort on the 8 byte prefixes, 16 bits a pass with all four histograms counted
+//in one read, so the sort itself never chases a name pointer. Only runs sharing all
+//8 bytes go through strcmp afterwards.
+size_t sortUniqueNames(char** names, size_t count) {
+    SortKey* keys = (SortKey*)malloc((count ? count : 1) * sizeof(SortKey));
+    SortKey* spare = (SortKey*)malloc((count ? count : 1) * sizeof(SortKey));
+    size_t (*histograms)[SORT_RADIX + 1] = (size_t (*)[SORT_RADIX + 1])calloc(4, sizeof(*histograms));
+    if (keys == NULL || spare == NULL || histograms == NULL) {
+        free(keys);
+        free(spare);
+        free(histograms);
+        return 0;
     }
-    
-    int cmp = strcmp(name, root->name);
-    if (cmp < 0) {
-        root->left = insertBST(root->left, name);
-    } else if (cmp > 0) {
-        root->right = insertBST(root->right, name);
+    for (size_t i = 0; i < count; i++) {
+        keys[i].prefix = namePrefix(names[i]);
+        keys[i].name = names[i];
+        for (int digit = 0; digit < 4; digit++) histograms[digit][((keys[i].prefix >> (16 * digit)) & (SORT_RADIX - 1)) + 1]++;
     }
-    
-    return root;
+    for (int digit = 0; digit < 4; digit++) {
+        size_t* buckets = histograms[digit];
+        int shift = 16 * digit;
+        //Every name has the same digit here, nothing to move
+        if (count == 0 || buckets[((keys[0].prefix >> shift) & (SORT_RADIX - 1)) + 1] == count) continue;
+        for (size_t b = 0; b < SORT_RADIX; b++) buckets[b + 1] += buckets[b];
+        for (size_t i = 0; i < count; i++) spare[buckets[(keys[i].prefix >> shift) & (SORT_RADIX - 1)]++] = keys[i];
+        SortKey* swap = keys;
+        keys = spare;
+        spare = swap;
+    }
+
+    size_t unique = 0;
+    for (size_t i = 0; i < count;) {
+        size_t run = i + 1;
+        while (run < count && keys[run].prefix == keys[i].prefix) run++;
+        if (run - i > 1) qsort(keys + i, run - i, sizeof(SortKey), compareKeys);
+        names[unique++] = keys[i].name;
+        for (i++; i < run; i++) {
+            if (compareKeys(&keys[i], &keys[i - 1]) != 0) names[unique++] = keys[i].name;
+        }
+    }
+    free(keys);
+    free(spare);
+    free(histograms);
+    return unique;
 }
 
+//Builds the index from already sorted, duplicate free names.
+//The caller keeps ownership of the strings passed in.
+NameIndex* buildNameIndex(char** sorted, uint32_t count) {
+    NameIndex* index = (NameIndex*)calloc(1, sizeof(NameIndex));
+    if (index == NULL) return NULL;
+    index->count = count;
+    if (!buildScoringBlocks(index, sorted, count) || !buildDawg(index, sorted, count)) {
+        freeNameIndex(index);
+        return NULL;
+    }
+    return index;
+}
 
-TreeNode* searchBST(TreeNode* root, const char* name) {
-    if (root == NULL) return NULL;
-    
-    int cmp = strcmp(name, root->name);
-    if (cmp == 0) return root;
-    
-    if (cmp < 0) return searchBST(root->left, name);
-    else return searchBST(root->right, name);
+int buildScoringBlocks(NameIndex* index, char** sorted, uint32_t count) {
+    uint32_t perLength[MAX_NAME_LENGTH] = {0};
+    for (uint32_t k = 0; k < count; k++) perLength[strnlen(sorted[k], MAX_NAME_LENGTH - 1)]++;
+
+    uint32_t blocks = 0;
+    size_t bytes = 0;
+    for (int length = 0; length < MAX_NAME_LENGTH; length++) {
+        index->lengthBlocks[length] = blocks;
+        index->lengthBytes[length] = bytes;
+        uint32_t lengthBlockCount = (perLength[length] + SCORE_LANES - 1) / SCORE_LANES;
+        blocks += lengthBlockCount;
+        bytes += (size_t)lengthBlockCount * length * SCORE_LANES;
+    }
+    index->lengthBlocks[MAX_NAME_LENGTH] = blocks;
+
+    index->blockChars = (uint8_t*)calloc(bytes ? bytes : 1, 1);
+    if (index->blockChars == NULL) return 0;
+
+    uint32_t filled[MAX_NAME_LENGTH] = {0};
+    for (uint32_t k = 0; k < count; k++) {
+        const char* name = sorted[k];
+        int length = (int)strnlen(name, MAX_NAME_LENGTH - 1);
+        uint32_t block = index->lengthBlocks[length] + filled[length] / SCORE_LANES;
+        uint32_t lane = filled[length]++ % SCORE_LANES;
+        uint8_t* chars = index->blockChars + index->lengthBytes[length] +
+                         (size_t)(block - index->lengthBlocks[length]) * length * SCORE_LANES;
+        for (int j = 0; j < length; j++) chars[j * SCORE_LANES + lane] = (uint8_t)name[j];
+    }
+    return 1;
 }
 
-//Freeing memory once the BST operations are done
-void freeBST(TreeNode* root) {
-    if (root != NULL) {
-        freeBST(root->left);
-        freeBST(root->right);
-        free(root);
+static uint64_t dawgNodeHash(uint8_t final, const uint8_t* labels, const uint32_t* targets, uint32_t edges) {
+    uint64_t hash = 1469598103934665603ull ^ final;
+    for (uint32_t e = 0; e < edges; e++) {
+        hash = (hash ^ labels[e]) * 1099511628211ull;
+        hash = (hash ^ targets[e]) * 1099511628211ull;
     }
+    return hash ^ (hash >> 29);
 }
 
-//Complicated  Levenshtein distance calculation
-int levenshteinDistance(const char* s1, const char* s2) {
+//Frozen node id for the open node at depth, either an identical existing one or a new one
+static uint32_t freezeDawgNode(NameIndex* index, DawgBuilder* builder, int depth) {
+    uint8_t final = builder->final[depth];
+    uint32_t edges = builder->edgeCount[depth];
+    const uint8_t* labels = builder->labels[depth];
+    const uint32_t* targets = builder->targets[depth];
+    size_t mask = builder->tableSize - 1;
+    size_t probe = dawgNodeHash(final, labels, targets, edges) & mask;
+    for (; builder->table[probe] != 0; probe = (probe + 1) & mask) {
+        uint32_t node = builder->table[probe] - 1;
+        uint32_t first = index->dawgFirstEdge[node];
+        if (index->dawgFinal[node] == final && index->dawgFirstEdge[node + 1] - first == edges &&
+            memcmp(index->dawgLabel + first, labels, edges) == 0 &&
+            memcmp(index->dawgTarget + first, targets, edges * sizeof(uint32_t)) == 0) {
+            return node;
+        }
+    }
+
+    if (index->dawgNodes == builder->nodeCapacity) {
+        uint32_t capacity = builder->nodeCapacity * 2;
+        uint32_t* firstEdge = (uint32_t*)realloc(index->dawgFirstEdge, (capacity + 1) * sizeof(uint32_t));
+        if (firstEdge) index->dawgFirstEdge = firstEdge;
+        uint8_t* finals = (uint8_t*)realloc(index->dawgFinal, capacity);
+        if (finals) index->dawgFinal = finals;
+        if (!firstEdge || !finals) return NODE_NONE;
+        builder->nodeCapacity = capacity;
+    }
+    while (index->dawgEdges + edges > builder->edgeCapacity) {
+        uint32_t capacity = builder->edgeCapacity * 2;
+        uint8_t* label = (uint8_t*)realloc(index->dawgLabel, capacity);
+        if (label) index->dawgLabel = label;
+        uint32_t* target = (uint32_t*)realloc(index->dawgTarget, capacity * sizeof(uint32_t));
+        if (target) index->dawgTarget = target;
+        if (!label || !target) return NODE_NONE;
+        builder->edgeCapacity = capacity;
+    }
+    //Edges are appended in node order, so the next node's first edge ends this one's
+    uint32_t node = index->dawgNodes++;
+    index->dawgFinal[node] = final;
+    memcpy(index->dawgLabel + index->dawgEdges, labels, edges);
+    memcpy(index->dawgTarget + index->dawgEdges, targets, edges * sizeof(uint32_t));
+    index->dawgEdges += edges;
+    index->dawgFirstEdge[node + 1] = index->dawgEdges;
+    builder->table[probe] = node + 1;
+
+    //Keep the register at most half full
+    if ((size_t)index->dawgNodes * 2 > builder->tableSize) {
+        size_t size = builder->tableSize * 2;
+        uint32_t* table = (uint32_t*)calloc(size, sizeof(uint32_t));
+        if (table == NULL) return NODE_NONE;
+        for (uint32_t n = 0; n < index->dawgNodes; n++) {
+            uint32_t first = index->dawgFirstEdge[n];
+            size_t at = dawgNodeHash(index->dawgFinal[n], index->dawgLabel + first, index->dawgTarget + first,
+                                     index->dawgFirstEdge[n + 1] - first) & (size - 1);
+            while (table[at] != 0) at = (at + 1) & (size - 1);
+            table[at] = n + 1;
+        }
+        free(builder->table);
+        builder->table = table;
+        builder->tableSize = size;
+    }
+    return node;
+}
+
+//Names come in sorted, so once the next name leaves the last one's path at depth p,
+//everything on that path below p is final and can be frozen (merged) bottom up.
+int buildDawg(NameIndex* index, char** sorted, uint32_t count) {
+    DawgBuilder* builder = (DawgBuilder*)calloc(1, sizeof(DawgBuilder));
+    if (builder == NULL) return 0;
+    builder->nodeCapacity = builder->edgeCapacity = 1024;
+    builder->tableSize = 2048;
+    builder->table = (uint32_t*)calloc(builder->tableSize, sizeof(uint32_t));
+    index->dawgFirstEdge = (uint32_t*)malloc((builder->nodeCapacity + 1) * sizeof(uint32_t));
+    index->dawgFinal = (uint8_t*)malloc(builder->nodeCapacity);
+    index->dawgLabel = (uint8_t*)malloc(builder->edgeCapacity);
+    index->dawgTarget = (uint32_t*)malloc(builder->edgeCapacity * sizeof(uint32_t));
+    index->dawgNodes = index->dawgEdges = 0;
+    int ok = builder->table && index->dawgFirstEdge && index->dawgFinal && index->dawgLabel && index->dawgTarget;
+    if (ok) index->dawgFirstEdge[0] = 0;
+
+    const char* previous = "";
+    int previousLength = 0;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        const char* name = sorted[i];
+        int length = (int)strnlen(name, MAX_NAME_LENGTH - 1);
+        int shared = 0;
+        while (shared < length && shared < previousLength && name[shared] == previous[shared]) shared++;
+
+        for (int depth = previousLength; ok && depth > shared; depth--) {
+            uint32_t node = freezeDawgNode(index, builder, depth);
+            builder->targets[depth - 1][builder->edgeCount[depth - 1] - 1] = node;
+            ok = node != NODE_NONE;
+        }
+        for (int depth = shared; depth < length; depth++) {
+            builder->labels[depth][builder->edgeCount[depth]++] = (uint8_t)name[depth];
+            builder->edgeCount[depth + 1] = 0;
+            builder->final[depth + 1] = 0;
+        }
+        builder->final[length] = 1;
+        previous = name;
+        previousLength = length;
+    }
+    for (int depth = previousLength; ok && depth > 0; depth--) {
+        uint32_t node = freezeDawgNode(index, builder, depth);
+        builder->targets[depth - 1][builder->edgeCount[depth - 1] - 1] = node;
+        ok = node != NODE_NONE;
+    }
+    if (ok) {
+        index->dawgRoot = freezeDawgNode(index, builder, 0);
+        ok = index->dawgRoot != NODE_NONE;
+    }
+    free(builder->table);
+    free(builder);
+    return ok;
+}
+
+//Exact lookup in O(length): one edge per character
+int dawgContains(const NameIndex* index, const char* name) {
+    uint32_t node = index->dawgRoot;
+    for (; *name; name++) {
+        const uint8_t* labels = index->dawgLabel + index->dawgFirstEdge[node];
+        uint32_t edges = index->dawgFirstEdge[node + 1] - index->dawgFirstEdge[node];
+        uint32_t e = 0;
+        while (e < edges && labels[e] < (uint8_t)*name) e++;
+        if (e == edges || labels[e] != (uint8_t)*name) return 0;
+        node = index->dawgTarget[index->dawgFirstEdge[node] + e];
+    }
+    return index->dawgFinal[node];
+}
+
+//Spells every name out of the DAWG (a depth first walk, so in sorted order) and lays them
+//out in slot order. Takes about what the names file does, free it when done.
+NameList* listNames(const NameIndex* index) {
+    NameList* list = (NameList*)calloc(1, sizeof(NameList));
+    char* sortedNames = NULL;
+    char** sorted = (char**)malloc((index->count ? index->count : 1) * sizeof(char*));
+    const char** slots = (const char**)malloc((index->count ? index->count : 1) * sizeof(char*));
+    size_t used = 0, capacity = 0;
+    uint32_t found = 0;
+    uint32_t nextEdge[MAX_NAME_LENGTH];
+    char path[MAX_NAME_LENGTH];
+    int ok = list && sorted && slots;
+
+    int depth = 0;
+    nextEdge[0] = index->dawgFirstEdge[index->dawgRoot];
+    uint32_t nodes[MAX_NAME_LENGTH];
+    nodes[0] = index->dawgRoot;
+    while (ok && depth >= 0) {
+        uint32_t node = nodes[depth];
+        if (nextEdge[depth] == index->dawgFirstEdge[node + 1] || depth >= MAX_NAME_LENGTH - 1) {
+            depth--;
+            continue;
+        }
+        uint32_t edge = nextEdge[depth]++;
+        uint32_t child = index->dawgTarget[edge];
+        path[depth] = (char)index->dawgLabel[edge];
+        if (index->dawgFinal[child] && found < index->count) {
+            if (used + depth + 2 > capacity) {
+                capacity = capacity ? capacity * 2 : 4096;
+                char* grown = (char*)realloc(sortedNames, capacity);
+                if (grown == NULL) {
+                    ok = 0;
+                    break;
+                }
+                sortedNames = grown;
+            }
+            memcpy(sortedNames + used, path, depth + 1);
+            sortedNames[used + depth + 1] = '\0';
+            sorted[found++] = (char*)(uintptr_t)used; //offset for now, the buffer still moves
+            used += depth + 2;
+        }
+        depth++;
+        nodes[depth] = child;
+        nextEdge[depth] = index->dawgFirstEdge[child];
+    }
+
+    if (ok) {
+        for (uint32_t k = 0; k < found; k++) sorted[k] = sortedNames + (uintptr_t)sorted[k];
+        fillSlots(sorted, 0, 0, found, slots);
+        list->names = (char*)malloc(used ? used : 1);
+        list->offsets = (uint32_t*)malloc((found ? found : 1) * sizeof(uint32_t));
+        ok = list->names && list->offsets && used <= UINT32_MAX;
+    }
+    if (ok) {
+        size_t at = 0;
+        for (uint32_t k = 0; k < found; k++) {
+            size_t length = strlen(slots[k]) + 1;
+            memcpy(list->names + at, slots[k], length);
+            list->offsets[k] = (uint32_t)at;
+            at += length;
+        }
+        list->count = found;
+    }
+    free(sortedNames);
+    free(sorted);
+    free(slots);
+    if (!ok) {
+        freeNameList(list);
+        return NULL;
+    }
+    return list;
+}
+
+void freeNameList(NameList* list) {
+    if (list == NULL) return;
+    free(list->names);
+    free(list->offsets);
+    free(list);
+}
+
+const char* indexName(const NameList* list, uint32_t slot) {
+    return list->names + list->offsets[slot];
+}
+
+//Iterative, so a huge roster can't blow the stack
+const char* searchNames(const NameList* list, const char* name) {
+    uint32_t slot = 0;
+    while (slot < list->count) {
+        const char* current = indexName(list, slot);
+        int cmp = strcmp(name, current);
+        if (cmp == 0) return current;
+        slot = 2 * slot + 1 + (cmp > 0);
+    }
+    return NULL;
+}
+
+//Freeing memory once the index is done with
+void freeNameIndex(NameIndex* index) {
+    if (index != NULL && index->mapping != NULL) {
+        munmap(index->mapping, index->mappingSize);
+        free(index);
+    } else if (index != NULL) {
+        free(index->blockChars);
+        free(index->dawgFirstEdge);
+        free(index->dawgFinal);
+        free(index->dawgLabel);
+        free(index->dawgTarget);
+        free(index);
+    }
+}
+
+//Complicated  Levenshtein distance calculation. The original full matrix version,
+//only kept as the reference the distance benchmark checks and times against.
+int levenshteinDistanceMatrix(const char* s1, const char* s2) {
     int len1 = strlen(s1);
     int len2 = strlen(s2);
 
@@ -114,74 +667,1080 @@ int levenshteinDistance(const char* s1, const char* s2) {
     return result;
 }
 
-//Closest match in BST
-void findClosestMatch(TreeNode* root, const char* input, char* bestMatch, int* bestDistance) {
-    if (root == NULL) return;
-    
-    int distance = levenshteinDistance(input, root->name);
-    if (distance < *bestDistance) {
-        *bestDistance = distance;
-        strncpy(bestMatch, root->name, MAX_NAME_LENGTH - 1);
-        bestMatch[MAX_NAME_LENGTH - 1] = '\0';
+//Bit-parallel edit distance (Myers, in Hyyro's formulation for global distance).
+//Column j of the DP table is kept as +1/-1 vertical deltas in two words, one bit per
+//character of the shorter string, so each character of the longer one costs a handful of
+//word ops and nothing is allocated. Names never get past MAX_NAME_LENGTH - 1 characters
+//(the loader and prompt cut them there) so one 64 bit word always holds a column.
+//Returns maxDistance + 1 as soon as the distance is known to exceed maxDistance.
+int boundedLevenshtein(const char* s1, const char* s2, int maxDistance) {
+    size_t len1 = strnlen(s1, MAX_NAME_LENGTH - 1);
+    size_t len2 = strnlen(s2, MAX_NAME_LENGTH - 1);
+    if (len1 > len2) {
+        const char* swap = s1;
+        s1 = s2;
+        s2 = swap;
+        size_t swapLength = len1;
+        len1 = len2;
+        len2 = swapLength;
     }
-    
-    findClosestMatch(root->left, input, bestMatch, bestDistance);
-    findClosestMatch(root->right, input, bestMatch, bestDistance);
+    //Every extra character costs at least one insertion
+    if ((int)(len2 - len1) > maxDistance) return maxDistance + 1;
+    if (len1 == 0) return (int)len2;
+
+    //Match masks, only for bytes that actually occur, so no 2KB table to clear
+    uint64_t peq[256];
+    for (size_t j = 0; j < len2; j++) peq[(unsigned char)s2[j]] = 0;
+    for (size_t i = 0; i < len1; i++) peq[(unsigned char)s1[i]] = 0;
+    for (size_t i = 0; i < len1; i++) peq[(unsigned char)s1[i]] |= 1ull << i;
+
+    uint64_t positive = ~0ull;
+    uint64_t negative = 0;
+    uint64_t last = 1ull << (len1 - 1);
+    int score = (int)len1;
+    for (size_t j = 0; j < len2; j++) {
+        uint64_t match = peq[(unsigned char)s2[j]];
+        uint64_t vertical = match | negative;
+        uint64_t horizontal = (((match & positive) + positive) ^ positive) | match;
+        uint64_t up = negative | ~(horizontal | positive);
+        uint64_t down = positive & horizontal;
+        if (up & last) score++;
+        else if (down & last) score--;
+        //Row 0 is 0,1,2,... so a +1 always comes in at the top
+        up = (up << 1) | 1;
+        down <<= 1;
+        positive = down | ~(vertical | up);
+        negative = up & vertical;
+        //Each remaining column can take the score down by at most one
+        if (score - (int)(len2 - j - 1) > maxDistance) return maxDistance + 1;
+    }
+    return score;
+}
+
+int levenshteinDistance(const char* s1, const char* s2) {
+    return boundedLevenshtein(s1, s2, INT_MAX - 1);
 }
 
-//Logging unknown name to file
+//Closest match in the roster within *bestDistance. Ties go to the alphabetically first
+//name, so the answer doesn't depend on how the index happens to be laid out.
+//Full roster scan, the reference the faster searches have to agree with.
+void scanClosestMatch(const NameList* list, const char* input, char* bestMatch, int* bestDistance) {
+    for (uint32_t slot = 0; slot < list->count; slot++) {
+        const char* name = indexName(list, slot);
+        //Anything worse than the best so far can stop early, equal still counts for the tie
+        int distance = boundedLevenshtein(input, name, *bestDistance);
+        if (distance < *bestDistance ||
+            (distance == *bestDistance && (bestMatch[0] == '\0' || strcmp(name, bestMatch) < 0))) {
+            *bestDistance = distance;
+            strncpy(bestMatch, name, MAX_NAME_LENGTH - 1);
+            bestMatch[MAX_NAME_LENGTH - 1] = '\0';
+        }
+    }
+}
+
+//The block scorers all run the plain DP row by row over the query, every lane a different
+//name, in saturating bytes. All lanes of a block have the same length, so the answer is
+//the last cell for everyone. When every lane's row minimum is past maxDistance the
+//block is done.
+static void scoreBlockScalar(const char* query, int queryLength, const uint8_t* block, int length,
+                             int maxDistance, uint8_t* distances) {
+    uint8_t rows[2][MAX_NAME_LENGTH][SCORE_LANES];
+    uint8_t (*previous)[SCORE_LANES] = rows[0];
+    uint8_t (*current)[SCORE_LANES] = rows[1];
+    for (int j = 0; j <= length; j++) memset(previous[j], j, SCORE_LANES);
+    for (int i = 1; i <= queryLength; i++) {
+        uint8_t c = (uint8_t)query[i - 1];
+        int rowMin = i;
+        memset(current[0], i, SCORE_LANES);
+        for (int j = 1; j <= length; j++) {
+            const uint8_t* chars = block + (j - 1) * SCORE_LANES;
+            for (int lane = 0; lane < SCORE_LANES; lane++) {
+                int best = previous[j - 1][lane] + (chars[lane] != c);
+                if (previous[j][lane] + 1 < best) best = previous[j][lane] + 1;
+                if (current[j - 1][lane] + 1 < best) best = current[j - 1][lane] + 1;
+                current[j][lane] = (uint8_t)best;
+                if (best < rowMin) rowMin = best;
+            }
+        }
+        if (rowMin > maxDistance) {
+            memset(distances, maxDistance + 1, SCORE_LANES);
+            return;
+        }
+        uint8_t (*swap)[SCORE_LANES] = previous;
+        previous = current;
+        current = swap;
+    }
+    memcpy(distances, previous[length], SCORE_LANES);
+}
+
+#ifdef HAVE_X86_KERNELS
+//SSE2 is in every x86-64, so this is the floor there. Two halves of a block per step.
+__attribute__((target("sse2")))
+static void scoreBlockSse2(const char* query, int queryLength, const uint8_t* block, int length,
+                           int maxDistance, uint8_t* distances) {
+    __m128i rows[2][MAX_NAME_LENGTH][2];
+    __m128i (*previous)[2] = rows[0];
+    __m128i (*current)[2] = rows[1];
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i limit = _mm_set1_epi8((char)maxDistance);
+    for (int j = 0; j <= length; j++) previous[j][0] = previous[j][1] = _mm_set1_epi8((char)j);
+    for (int i = 1; i <= queryLength; i++) {
+        __m128i c = _mm_set1_epi8(query[i - 1]);
+        __m128i rowMin = _mm_set1_epi8((char)i);
+        current[0][0] = current[0][1] = rowMin;
+        for (int j = 1; j <= length; j++) {
+            for (int half = 0; half < 2; half++) {
+                __m128i chars = _mm_loadu_si128((const __m128i*)(block + (j - 1) * SCORE_LANES + half * 16));
+                __m128i cost = _mm_andnot_si128(_mm_cmpeq_epi8(chars, c), one);
+                __m128i best = _mm_adds_epu8(previous[j - 1][half], cost);
+                best = _mm_min_epu8(best, _mm_adds_epu8(previous[j][half], one));
+                best = _mm_min_epu8(best, _mm_adds_epu8(current[j - 1][half], one));
+                current[j][half] = best;
+                rowMin = _mm_min_epu8(rowMin, best);
+            }
+        }
+        //rowMin <= limit in some lane <=> min(rowMin, limit) == rowMin there
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(rowMin, limit), rowMin)) == 0) {
+            memset(distances, maxDistance + 1, SCORE_LANES);
+            return;
+        }
+        __m128i (*swap)[2] = previous;
+        previous = current;
+        current = swap;
+    }
+    _mm_storeu_si128((__m128i*)distances, previous[length][0]);
+    _mm_storeu_si128((__m128i*)(distances + 16), previous[length][1]);
+}
+
+__attribute__((target("avx2")))
+static void scoreBlockAvx2(const char* query, int queryLength, const uint8_t* block, int length,
+                           int maxDistance, uint8_t* distances) {
+    __m256i rows[2][MAX_NAME_LENGTH];
+    __m256i* previous = rows[0];
+    __m256i* current = rows[1];
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i limit = _mm256_set1_epi8((char)maxDistance);
+    for (int j = 0; j <= length; j++) previous[j] = _mm256_set1_epi8((char)j);
+    for (int i = 1; i <= queryLength; i++) {
+        __m256i c = _mm256_set1_epi8(query[i - 1]);
+        __m256i rowMin = _mm256_set1_epi8((char)i);
+        current[0] = rowMin;
+        for (int j = 1; j <= length; j++) {
+            __m256i chars = _mm256_loadu_si256((const __m256i*)(block + (j - 1) * SCORE_LANES));
+            __m256i cost = _mm256_andnot_si256(_mm256_cmpeq_epi8(chars, c), one);
+            __m256i best = _mm256_adds_epu8(previous[j - 1], cost);
+            best = _mm256_min_epu8(best, _mm256_adds_epu8(previous[j], one));
+            best = _mm256_min_epu8(best, _mm256_adds_epu8(current[j - 1], one));
+            current[j] = best;
+            rowMin = _mm256_min_epu8(rowMin, best);
+        }
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(rowMin, limit), rowMin)) == 0) {
+            memset(distances, maxDistance + 1, SCORE_LANES);
+            return;
+        }
+        __m256i* swap = previous;
+        previous = current;
+        current = swap;
+    }
+    _mm256_storeu_si256((__m256i*)distances, previous[length]);
+}
+#endif
+
+static BlockScorer scoreBlock = scoreBlockScalar;
+
+//Picks the widest kernel the CPU has (CPUID through the compiler builtins), or the one
+//named in forced ("avx2", "sse2", "scalar") if it's usable. Returns the name of the pick.
+const char* selectBlockScorer(const char* forced) {
+    scoreBlock = scoreBlockScalar;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    int avx2 = __builtin_cpu_supports("avx2");
+    int sse2 = __builtin_cpu_supports("sse2");
+    if (forced == NULL || strcmp(forced, "avx2") == 0) {
+        if (avx2) {
+            scoreBlock = scoreBlockAvx2;
+            return "avx2";
+        }
+    }
+    if (forced == NULL || strcmp(forced, "avx2") == 0 || strcmp(forced, "sse2") == 0) {
+        if (sse2) {
+            scoreBlock = scoreBlockSse2;
+            return "sse2";
+        }
+    }
+#else
+    (void)forced;
+#endif
+    return "scalar";
+}
+
+//Closest match by scoring whole blocks: only lengths within *bestDistance of the input can
+//be close enough, and those are scored SCORE_LANES names per kernel call. Same answer as
+//scanClosestMatch. Returns how many names were scored.
+uint32_t blockClosestMatch(const NameIndex* index, const char* input, char* bestMatch, int* bestDistance) {
+    int inputLength = (int)strnlen(input, MAX_NAME_LENGTH - 1);
+    uint32_t scored = 0;
+    uint8_t distances[SCORE_LANES];
+    //Nearest lengths first, a close name there shrinks the window for the rest
+    for (int offset = 0; offset <= *bestDistance && offset < MAX_NAME_LENGTH; offset++) {
+        for (int side = 0; side < (offset ? 2 : 1); side++) {
+            int length = side ? inputLength - offset : inputLength + offset;
+            if (length < 0 || length >= MAX_NAME_LENGTH || offset > *bestDistance) continue;
+            const uint8_t* chars = index->blockChars + index->lengthBytes[length];
+            for (uint32_t block = index->lengthBlocks[length]; block < index->lengthBlocks[length + 1]; block++) {
+                int limit = *bestDistance < 254 ? *bestDistance : 254;
+                scoreBlock(input, inputLength, chars, length, limit, distances);
+                //Only a length's last block is padded, and a padding lane's first byte is 0
+                int lanes = SCORE_LANES;
+                if (block + 1 == index->lengthBlocks[length + 1] && length > 0)
+                    while (lanes > 0 && chars[lanes - 1] == 0) lanes--;
+                for (int lane = 0; lane < lanes; lane++) {
+                    scored++;
+                    if (distances[lane] > *bestDistance) continue;
+                    char name[MAX_NAME_LENGTH];
+                    for (int j = 0; j < length; j++) name[j] = (char)chars[j * SCORE_LANES + lane];
+                    name[length] = '\0';
+                    if (distances[lane] < *bestDistance || bestMatch[0] == '\0' || strcmp(name, bestMatch) < 0) {
+                        *bestDistance = distances[lane];
+                        memcpy(bestMatch, name, length + 1);
+                    }
+                }
+                chars += (size_t)length * SCORE_LANES;
+            }
+        }
+    }
+    return scored;
+}
+
+//Walks the DAWG against a Levenshtein automaton for the input. The automaton's state after
+//a prefix is one DP row (distance from every input prefix to the path so far); its smallest
+//cell bounds every name below, so once that passes the best distance the whole subtree is
+//skipped. Names come out in strcmp order, so after a hit only strictly closer names are
+//still worth looking for. Returns edges followed.
+static uint32_t walkDawg(const NameIndex* index, const char* input, char* bestMatch, int* bestDistance) {
+    int inputLength = (int)strnlen(input, MAX_NAME_LENGTH - 1);
+    uint8_t rows[MAX_NAME_LENGTH][MAX_NAME_LENGTH];
+    uint32_t nextEdge[MAX_NAME_LENGTH];
+    uint32_t endEdge[MAX_NAME_LENGTH];
+    char path[MAX_NAME_LENGTH];
+    uint32_t followed = 0;
+    int foundHere = 0;
+
+    for (int i = 0; i <= inputLength; i++) rows[0][i] = (uint8_t)i;
+    nextEdge[0] = index->dawgFirstEdge[index->dawgRoot];
+    endEdge[0] = index->dawgFirstEdge[index->dawgRoot + 1];
+    int depth = 0;
+    while (depth >= 0) {
+        if (nextEdge[depth] == endEdge[depth]) {
+            depth--;
+            continue;
+        }
+        uint32_t edge = nextEdge[depth]++;
+        uint8_t c = index->dawgLabel[edge];
+        uint32_t child = index->dawgTarget[edge];
+        followed++;
+
+        const uint8_t* previous = rows[depth];
+        uint8_t* row = rows[depth + 1];
+        int rowMin = row[0] = (uint8_t)(depth + 1);
+        for (int i = 1; i <= inputLength; i++) {
+            int best = previous[i - 1] + ((uint8_t)input[i - 1] != c);
+            if (previous[i] + 1 < best) best = previous[i] + 1;
+            if (row[i - 1] + 1 < best) best = row[i - 1] + 1;
+            row[i] = (uint8_t)best;
+            if (best < rowMin) rowMin = best;
+        }
+        path[depth] = (char)c;
+        path[depth + 1] = '\0';
+
+        if (index->dawgFinal[child]) {
+            int distance = row[inputLength];
+            if (distance < *bestDistance ||
+                (distance == *bestDistance && !foundHere && (bestMatch[0] == '\0' || strcmp(path, bestMatch) < 0))) {
+                *bestDistance = distance;
+                memcpy(bestMatch, path, depth + 2);
+                foundHere = 1;
+            }
+        }
+        int limit = foundHere ? *bestDistance - 1 : *bestDistance;
+        if (rowMin > limit || depth + 1 >= MAX_NAME_LENGTH - 1) continue;
+        depth++;
+        nextEdge[depth] = index->dawgFirstEdge[child];
+        endEdge[depth] = index->dawgFirstEdge[child + 1];
+    }
+    return followed;
+}
+
+//Closest match from the DAWG, one automaton per distance: a walk at k=1 only wanders a
+//sliver of the graph, so the usual one-letter typo never pays for the k=3 walk.
+//The first k with a hit has the answer. Returns edges followed over all walks.
+uint32_t dawgClosestMatch(const NameIndex* index, const char* input, char* bestMatch, int* bestDistance) {
+    uint32_t followed = 0;
+    for (int limit = 0; limit <= *bestDistance; limit++) {
+        char match[MAX_NAME_LENGTH] = "";
+        int distance = limit;
+        followed += walkDawg(index, input, match, &distance);
+        if (match[0] != '\0') {
+            if (distance < *bestDistance || bestMatch[0] == '\0' || strcmp(match, bestMatch) < 0) {
+                *bestDistance = distance;
+                strcpy(bestMatch, match);
+            }
+            break;
+        }
+    }
+    return followed;
+}
+
+//The suggestion path. One letter typos are the common case, and the DAWG walks at k<=1
+//find them touching a sliver of the graph. Wider walks wander through much more of it,
+//and with vector units scoring the plausible lengths 32 names at a time is quicker there.
+uint32_t findClosestMatch(const NameIndex* index, const char* input, char* bestMatch, int* bestDistance) {
+    if (scoreBlock == scoreBlockScalar || *bestDistance <= 1) {
+        return dawgClosestMatch(index, input, bestMatch, bestDistance);
+    }
+    int narrow = 1;
+    uint32_t work = dawgClosestMatch(index, input, bestMatch, &narrow);
+    if (bestMatch[0] != '\0') {
+        *bestDistance = narrow;
+        return work;
+    }
+    return work + blockClosestMatch(index, input, bestMatch, bestDistance);
+}
+
+static AuditLog audit = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .drained = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+};
+
+//Where name lives in the batch: its own slot, or the empty one it would go in
+static AuditEntry* auditSlot(AuditBatch* batch, const char* name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)name; *c; c++) hash = (hash ^ *c) * 16777619u;
+    for (uint32_t slot = hash & (AUDIT_TABLE_SLOTS - 1);; slot = (slot + 1) & (AUDIT_TABLE_SLOTS - 1)) {
+        AuditEntry* entry = &batch->slots[slot];
+        if (entry->count == 0 || strcmp(entry->name, name) == 0) return entry;
+    }
+}
+
+static int writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+//One line per name in the batch: name, times denied, first and last denial.
+//Empties the batch for reuse as it goes.
+static int writeAuditBatch(AuditBatch* batch) {
+    static char buffer[AUDIT_BUFFER_BYTES];
+    size_t used = 0;
+    int failed = 0;
+    for (uint32_t i = 0; i < batch->used; i++) {
+        AuditEntry* entry = &batch->slots[batch->order[i]];
+        char first[32], last[32];
+        struct tm when;
+        strftime(first, sizeof(first), "%Y-%m-%d %H:%M:%S", localtime_r(&entry->firstSeen, &when));
+        strftime(last, sizeof(last), "%Y-%m-%d %H:%M:%S", localtime_r(&entry->lastSeen, &when));
+        if (AUDIT_BUFFER_BYTES - used < MAX_NAME_LENGTH + 96) {
+            failed |= writeAll(audit.fd, buffer, used);
+            used = 0;
+        }
+        used += (size_t)snprintf(buffer + used, AUDIT_BUFFER_BYTES - used, "%s\t%u\t%s\t%s\n",
+                                 entry->name, entry->count, first, last);
+        entry->count = 0;
+    }
+    if (used > 0) failed |= writeAll(audit.fd, buffer, used);
+    batch->used = 0;
+    return failed;
+}
+
+static void* auditWriter(void* arg) {
+    (void)arg;
+    time_t lastSync = time(NULL);
+    int dirty = 0;
+    pthread_mutex_lock(&audit.lock);
+    while (1) {
+        if (!audit.stopping && audit.batches[audit.active].used < AUDIT_MAX_PENDING) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (AUDIT_FLUSH_MS % 1000) * 1000000L;
+            deadline.tv_sec += AUDIT_FLUSH_MS / 1000 + deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&audit.wake, &audit.lock, &deadline);
+        }
+        int stopping = audit.stopping;
+        AuditBatch* batch = &audit.batches[audit.active];
+        if (batch->used > 0) {
+            audit.active ^= 1;
+            pthread_cond_broadcast(&audit.drained);
+        } else {
+            batch = NULL;
+        }
+        pthread_mutex_unlock(&audit.lock);
+
+        if (batch != NULL) {
+            if (writeAuditBatch(batch) != 0) printf("Error couldn't write to %s\n", UNKNOWN_NAMES_FILE);
+            dirty = 1;
+        }
+        time_t now = time(NULL);
+        if (dirty && (stopping || now - lastSync >= AUDIT_FSYNC_SECONDS)) {
+            fsync(audit.fd);
+            lastSync = now;
+            dirty = 0;
+        }
+
+        pthread_mutex_lock(&audit.lock);
+        if (stopping) break;
+    }
+    pthread_mutex_unlock(&audit.lock);
+    return NULL;
+}
+
+//Opens the log for appending and starts the writer thread
+int startAuditLog(const char* path) {
+    audit.fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (audit.fd < 0) return -1;
+    audit.stopping = 0;
+    if (pthread_create(&audit.thread, NULL, auditWriter, NULL) != 0) {
+        close(audit.fd);
+        audit.fd = -1;
+        return -1;
+    }
+    pthread_mutex_lock(&audit.lock);
+    audit.running = 1;
+    pthread_mutex_unlock(&audit.lock);
+    return 0;
+}
+
+//Queues an unknown name for the audit writer. Only waits if the writer has fallen a
+//whole batch behind.
 void logUnknownName(const char* name) {
-    FILE* file = fopen(UNKNOWN_NAMES_FILE, "a");
-    if (file != NULL) {
-        fprintf(file, "%s\n", name);
-        fclose(file);
-        printf("Unknown name '%s' has been logged for reviewing.\n", name);
+    time_t now = time(NULL);
+    pthread_mutex_lock(&audit.lock);
+    AuditBatch* batch;
+    AuditEntry* entry;
+    while (1) {
+        if (!audit.running) {
+            pthread_mutex_unlock(&audit.lock);
+            printf("Error couldn't log name\n");
+            return;
+        }
+        batch = &audit.batches[audit.active];
+        entry = auditSlot(batch, name);
+        if (entry->count != 0 || batch->used < AUDIT_MAX_PENDING) break;
+        pthread_cond_signal(&audit.wake);
+        pthread_cond_wait(&audit.drained, &audit.lock);
+    }
+    if (entry->count == 0) {
+        snprintf(entry->name, sizeof(entry->name), "%s", name);
+        entry->firstSeen = now;
+        batch->order[batch->used++] = (uint32_t)(entry - batch->slots);
+        if (batch->used == AUDIT_MAX_PENDING) pthread_cond_signal(&audit.wake);
+    }
+    entry->count++;
+    entry->lastSeen = now;
+    pthread_mutex_unlock(&audit.lock);
+    printf("Unknown name '%s' has been logged for reviewing.\n", name);
+}
+
+//Writes out whatever is still queued, fsyncs and stops the writer
+void stopAuditLog(void) {
+    pthread_mutex_lock(&audit.lock);
+    if (!audit.running) {
+        pthread_mutex_unlock(&audit.lock);
+        return;
+    }
+    audit.running = 0;
+    audit.stopping = 1;
+    pthread_cond_signal(&audit.wake);
+    pthread_cond_broadcast(&audit.drained);
+    pthread_mutex_unlock(&audit.lock);
+    pthread_join(audit.thread, NULL);
+    close(audit.fd);
+    audit.fd = -1;
+}
+
+//Hot reload. The roster in use is an immutable NameIndex behind liveIndex. The watcher
+//thread builds a whole new index off to the side and swaps the pointer, so a lookup
+//sees either the old roster or the new one, never half of one, and never waits.
+//
+//Old snapshots are freed by epoch: a pin claims a free slot by announcing the global
+//epoch in it before loading liveIndex, and unpinning clears the slot for the next pin.
+//A snapshot swapped out at epoch E can only still be in use by a pin that announced E
+//or earlier. Slots belong to pins, not threads, so any number of threads may read.
+static _Atomic(NameIndex*) liveIndex;
+static atomic_uint_fast64_t globalEpoch = 1;
+static atomic_uint_fast64_t readerEpochs[MAX_INDEX_READERS]; //0 while free
+static _Thread_local int readerSlot = -1; //this thread's pin
+static RetiredIndex* retiredIndexes; //watcher thread only
+static char watchedDirectory[PATH_MAX];
+static char watchedName[PATH_MAX];
+static char watchedPath[PATH_MAX];
+static int watchStop[2] = { -1, -1 };
+static pthread_t watcherThread;
+static int watcherRunning;
+
+//The current roster, good until unpinIndex(). Pins don't nest.
+const NameIndex* pinIndex(void) {
+    for (int slot = 0;; slot = (slot + 1) % MAX_INDEX_READERS) {
+        //An epoch that went stale before the claim only makes reclaiming wait longer
+        uint_fast64_t unclaimed = 0;
+        if (atomic_compare_exchange_strong(&readerEpochs[slot], &unclaimed, atomic_load(&globalEpoch))) {
+            readerSlot = slot;
+            return atomic_load(&liveIndex);
+        }
+        if (slot == MAX_INDEX_READERS - 1) sched_yield();
+    }
+}
+
+void unpinIndex(void) {
+    atomic_store_explicit(&readerEpochs[readerSlot], 0, memory_order_release);
+    readerSlot = -1;
+}
+
+//Frees every retired snapshot older than the oldest reader still pinned
+static void reclaimIndexes(void) {
+    uint64_t oldest = UINT64_MAX;
+    for (int r = 0; r < MAX_INDEX_READERS; r++) {
+        uint64_t epoch = atomic_load(&readerEpochs[r]);
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+    RetiredIndex** link = &retiredIndexes;
+    while (*link != NULL) {
+        RetiredIndex* retired = *link;
+        if (retired->epoch < oldest) {
+            *link = retired->next;
+            freeNameIndex(retired->index);
+            free(retired);
+        } else {
+            link = &retired->next;
+        }
+    }
+}
+
+static void publishIndex(NameIndex* index) {
+    NameIndex* old = atomic_exchange(&liveIndex, index);
+    uint64_t epoch = atomic_fetch_add(&globalEpoch, 1);
+    RetiredIndex* retired = (RetiredIndex*)malloc(sizeof(RetiredIndex));
+    if (retired == NULL) {
+        //Can't track it, leaking it is the only safe thing left
+        printf("Warning: Out of memory, the old roster won't be freed\n");
+        return;
+    }
+    retired->index = old;
+    retired->epoch = epoch;
+    retired->next = retiredIndexes;
+    retiredIndexes = retired;
+    reclaimIndexes();
+}
+
+//Whether the events just read include the roster being written or moved into place
+static int rosterChanged(const char* events, ssize_t length) {
+    int changed = 0;
+    for (ssize_t at = 0; at < length;) {
+        const struct inotify_event* event = (const struct inotify_event*)(events + at);
+        if (event->len > 0 && strcmp(event->name, watchedName) == 0) changed = 1;
+        at += (ssize_t)(sizeof(struct inotify_event) + event->len);
+    }
+    return changed;
+}
+
+//Watches the roster's directory rather than the file itself so editors that save by
+//renaming a new file over the old one are seen too. Waits for RELOAD_SETTLE_MS of quiet
+//after a change, then reloads. A roster that fails to load leaves the old one in use.
+static void* watchRoster(void* arg) {
+    int notify = (int)(intptr_t)arg;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd waits[2] = { { .fd = notify, .events = POLLIN }, { .fd = watchStop[0], .events = POLLIN } };
+    int pending = 0;
+    while (1) {
+        int timeout = pending || retiredIndexes != NULL ? RELOAD_SETTLE_MS : -1;
+        int ready = poll(waits, 2, timeout);
+        if (ready < 0 && errno != EINTR) break;
+        if (waits[1].revents) break;
+        if (ready > 0 && waits[0].revents) {
+            ssize_t length = read(notify, events, sizeof(events));
+            if (length > 0 && rosterChanged(events, length)) pending = 1;
+            continue;
+        }
+        if (pending) {
+            pending = 0;
+            printf("\nRoster '%s' changed, reloading...\n", watchedPath);
+            NameIndex* index = loadNamesFromFile(watchedPath);
+            if (index != NULL) publishIndex(index);
+            else printf("Reload failed, still using the previous roster.\n");
+        }
+        reclaimIndexes();
+    }
+    close(notify);
+    return NULL;
+}
+
+//Makes initial the live roster and starts reloading it whenever filename changes.
+//Without inotify the roster just stays as loaded.
+int startRosterWatcher(const char* filename, NameIndex* initial) {
+    atomic_store(&liveIndex, initial);
+    const char* slash = strrchr(filename, '/');
+    if (slash == NULL) {
+        snprintf(watchedDirectory, sizeof(watchedDirectory), ".");
+        snprintf(watchedName, sizeof(watchedName), "%s", filename);
     } else {
-        printf("Error couldn't log name\n");
+        snprintf(watchedDirectory, sizeof(watchedDirectory), "%.*s", slash == filename ? 1 : (int)(slash - filename), filename);
+        snprintf(watchedName, sizeof(watchedName), "%s", slash + 1);
     }
+    snprintf(watchedPath, sizeof(watchedPath), "%s", filename);
+
+    int notify = inotify_init1(IN_CLOEXEC);
+    if (notify < 0) return -1;
+    if (inotify_add_watch(notify, watchedDirectory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 || pipe(watchStop) != 0) {
+        close(notify);
+        return -1;
+    }
+    if (pthread_create(&watcherThread, NULL, watchRoster, (void*)(intptr_t)notify) != 0) {
+        close(notify);
+        close(watchStop[0]);
+        close(watchStop[1]);
+        return -1;
+    }
+    watcherRunning = 1;
+    return 0;
+}
+
+//Stops the watcher and frees the live roster and every retired one. No reader may
+//be pinned.
+void stopRosterWatcher(void) {
+    if (watcherRunning) {
+        if (write(watchStop[1], "", 1) < 0) printf("Error stopping the roster watcher\n");
+        pthread_join(watcherThread, NULL);
+        close(watchStop[0]);
+        close(watchStop[1]);
+        watcherRunning = 0;
+    }
+    while (retiredIndexes != NULL) {
+        RetiredIndex* retired = retiredIndexes;
+        retiredIndexes = retired->next;
+        freeNameIndex(retired->index);
+        free(retired);
+    }
+    freeNameIndex(atomic_exchange(&liveIndex, NULL));
+}
+
+static double elapsedMs(const struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1e3 + (now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+//Cuts the chunk's lines into NUL terminated names right inside the private mapping,
+//then sorts and dedups them. Chunks start on a line boundary, so no line is shared.
+void* parseChunk(void* arg) {
+    LoadChunk* chunk = (LoadChunk*)arg;
+    size_t at = chunk->start;
+    while (at < chunk->end) {
+        char* line = chunk->data + at;
+        char* newline = (char*)memchr(line, '\n', chunk->size - at);
+        size_t length = newline ? (size_t)(newline - line) : chunk->size - at;
+        at += length + 1;
+        //Last line without a newline is handled by the caller, there's no byte to put a NUL in
+        if (newline == NULL) break;
+        if (length > 0 && line[length - 1] == '\r') length--;
+        if (length == 0) continue;
+        if (length > MAX_NAME_LENGTH - 1) length = MAX_NAME_LENGTH - 1;
+        line[length] = '\0';
+
+        if (chunk->count == chunk->capacity) {
+            size_t capacity = chunk->capacity ? chunk->capacity * 2 : 4096;
+            char** grown = (char**)realloc(chunk->names, capacity * sizeof(char*));
+            if (grown == NULL) break;
+            chunk->names = grown;
+            chunk->capacity = capacity;
+        }
+        chunk->names[chunk->count++] = line;
+    }
+    chunk->lines = chunk->count;
+    chunk->count = sortUniqueNames(chunk->names, chunk->count);
+    return NULL;
+}
+
+void* mergeChunks(void* arg) {
+    MergeJob* job = (MergeJob*)arg;
+    char** a = job->left->names;
+    char** b = job->right->names;
+    size_t i = 0, j = 0, n = 0;
+    while (i < job->left->count && j < job->right->count) {
+        int cmp = strcmp(a[i], b[j]);
+        if (cmp <= 0) job->merged[n++] = a[i++];
+        else job->merged[n++] = b[j++];
+        if (cmp == 0) j++;
+    }
+    while (i < job->left->count) job->merged[n++] = a[i++];
+    while (j < job->right->count) job->merged[n++] = b[j++];
+    job->count = n;
+    return NULL;
 }
 
-//Loading names from file
-TreeNode* loadNamesFromFile(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        printf("Error: Couldn't not open file '%s'. Make sure it really doest exist\n", filename);
+//The arrays of a NameIndex in compiled file order, with their sizes in bytes
+static void rosterSections(NameIndex* index, void** fields[ROSTER_SECTIONS], size_t sizes[ROSTER_SECTIONS]) {
+    size_t lastLength = MAX_NAME_LENGTH - 1;
+    size_t blockBytes = index->lengthBytes[lastLength] +
+                        (size_t)(index->lengthBlocks[MAX_NAME_LENGTH] - index->lengthBlocks[lastLength]) * lastLength * SCORE_LANES;
+    int s = 0;
+    fields[s] = (void**)&index->blockChars;    sizes[s++] = blockBytes;
+    fields[s] = (void**)&index->dawgFirstEdge; sizes[s++] = ((size_t)index->dawgNodes + 1) * sizeof(uint32_t);
+    fields[s] = (void**)&index->dawgFinal;     sizes[s++] = index->dawgNodes;
+    fields[s] = (void**)&index->dawgLabel;     sizes[s++] = index->dawgEdges;
+    fields[s] = (void**)&index->dawgTarget;    sizes[s++] = (size_t)index->dawgEdges * sizeof(uint32_t);
+}
+
+//Everything about a roster that the header alone settles: the root and edge range of
+//the DAWG, and a block layout that adds up to the blockChars section rosterSections sized
+//from it. Cheap enough for every load.
+static int rosterShapeValid(const NameIndex* index) {
+    if (index->dawgNodes == 0 || index->dawgRoot >= index->dawgNodes || index->dawgFirstEdge[0] != 0 ||
+        index->dawgFirstEdge[index->dawgNodes] != index->dawgEdges || index->lengthBlocks[0] != 0) {
+        return 0;
+    }
+    uint64_t bytes = 0;
+    for (int length = 0; length < MAX_NAME_LENGTH; length++) {
+        if (index->lengthBlocks[length + 1] < index->lengthBlocks[length] || index->lengthBytes[length] != bytes) return 0;
+        bytes += (uint64_t)(index->lengthBlocks[length + 1] - index->lengthBlocks[length]) * length * SCORE_LANES;
+    }
+    return (uint64_t)index->count <= (uint64_t)index->lengthBlocks[MAX_NAME_LENGTH] * SCORE_LANES;
+}
+
+//The full check, a walk over every node and edge: edges in bounds and sorted, every
+//target a node. Too slow for every load of a huge roster, so compileRoster runs it on
+//what it wrote and --verify on anything else.
+static int validRoster(const NameIndex* index) {
+    if (!rosterShapeValid(index)) return 0;
+    for (uint32_t node = 0; node < index->dawgNodes; node++) {
+        uint32_t first = index->dawgFirstEdge[node], end = index->dawgFirstEdge[node + 1];
+        if (end < first || end > index->dawgEdges) return 0;
+        for (uint32_t edge = first; edge < end; edge++) {
+            if (index->dawgTarget[edge] >= index->dawgNodes || index->dawgLabel[edge] == 0 ||
+                (edge > first && index->dawgLabel[edge] <= index->dawgLabel[edge - 1])) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+//Serves a compiled roster straight from the page cache: the header is checked and the
+//index pointed at the mapped arrays, nothing else is read or copied, so startup takes
+//the same time for any roster size. Only what the header settles is checked here; the
+//arrays are trusted as compileRoster wrote and verified them.
+NameIndex* mapRosterFile(int fd, size_t size) {
+    if (size < sizeof(RosterFileHeader)) return NULL;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) return NULL;
+    const RosterFileHeader* header = (const RosterFileHeader*)mapping;
+    NameIndex* index = NULL;
+    if (memcmp(header->magic, ROSTER_MAGIC, sizeof(header->magic)) != 0 || header->version != ROSTER_VERSION ||
+        header->byteOrder != ROSTER_BYTE_ORDER || header->maxNameLength != MAX_NAME_LENGTH ||
+        header->scoreLanes != SCORE_LANES || header->fileSize != size || header->dawgNodes == UINT32_MAX ||
+        (index = (NameIndex*)calloc(1, sizeof(NameIndex))) == NULL) {
+        munmap(mapping, size);
         return NULL;
     }
-    
-    TreeNode* root = NULL;
-    char name[MAX_NAME_LENGTH];
-    int count = 0;
-    
-    printf("Loading names from '%s'...\n", filename);
-    
-    while (fgets(name, sizeof(name), file) != NULL && count < MAX_NAMES) {
-        //Remove newline character. because YAH we got to.
-        name[strcspn(name, "\n")] = '\0';
-        
-        if (strlen(name) > 0) {
-            root = insertBST(root, name);
-            count++;
-            printf("Loaded: %s\n", name);
+    index->count = header->count;
+    index->dawgNodes = header->dawgNodes;
+    index->dawgEdges = header->dawgEdges;
+    index->dawgRoot = header->dawgRoot;
+    memcpy(index->lengthBlocks, header->lengthBlocks, sizeof(index->lengthBlocks));
+    for (int length = 0; length < MAX_NAME_LENGTH; length++) index->lengthBytes[length] = header->lengthBytes[length];
+    index->mapping = mapping;
+    index->mappingSize = size;
+
+    void** fields[ROSTER_SECTIONS];
+    size_t sizes[ROSTER_SECTIONS];
+    rosterSections(index, fields, sizes);
+    for (int s = 0; s < ROSTER_SECTIONS; s++) {
+        uint64_t offset = header->sectionOffset[s];
+        if (header->sectionBytes[s] != sizes[s] || offset % ROSTER_ALIGN != 0 || offset > size || sizes[s] > size - offset) {
+            freeNameIndex(index);
+            return NULL;
         }
+        *fields[s] = (char*)mapping + offset;
     }
-    
-    fclose(file);
-    printf("Successfully loaded %d names.\n", count);
-    return root;
+    if (!rosterShapeValid(index)) {
+        freeNameIndex(index);
+        return NULL;
+    }
+    return index;
+}
+
+//Maps a compiled roster and runs the full check on it, for rosters that didn't come
+//straight from this build's --compile.
+int verifyRoster(const char* indexFile) {
+    int fd = open(indexFile, O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        if (fd != -1) close(fd);
+        printf("Error: Couldn't open '%s'.\n", indexFile);
+        return 1;
+    }
+    NameIndex* index = mapRosterFile(fd, (size_t)info.st_size);
+    close(fd);
+    int valid = index != NULL && validRoster(index);
+    if (valid) printf("'%s' is a valid roster of %u names.\n", indexFile, index->count);
+    else printf("Error: '%s' is damaged or isn't a roster this build can use.\n", indexFile);
+    freeNameIndex(index);
+    return !valid;
+}
+
+//Offline step: loads a names file and writes its whole index, exact and fuzzy, as one
+//compiled roster. Written to a temporary file, fully checked, and renamed over indexFile,
+//so a running system watching it only ever maps a complete, valid one.
+int compileRoster(const char* namesFile, const char* indexFile) {
+    NameIndex* index = loadNamesFromFile(namesFile);
+    if (index == NULL) return 1;
+
+    RosterFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ROSTER_MAGIC, sizeof(header.magic));
+    header.version = ROSTER_VERSION;
+    header.byteOrder = ROSTER_BYTE_ORDER;
+    header.maxNameLength = MAX_NAME_LENGTH;
+    header.scoreLanes = SCORE_LANES;
+    header.count = index->count;
+    header.dawgNodes = index->dawgNodes;
+    header.dawgEdges = index->dawgEdges;
+    header.dawgRoot = index->dawgRoot;
+    memcpy(header.lengthBlocks, index->lengthBlocks, sizeof(header.lengthBlocks));
+    for (int length = 0; length < MAX_NAME_LENGTH; length++) header.lengthBytes[length] = index->lengthBytes[length];
+
+    void** fields[ROSTER_SECTIONS];
+    size_t sizes[ROSTER_SECTIONS];
+    rosterSections(index, fields, sizes);
+    uint64_t at = (sizeof(header) + ROSTER_ALIGN - 1) & ~(uint64_t)(ROSTER_ALIGN - 1);
+    for (int s = 0; s < ROSTER_SECTIONS; s++) {
+        header.sectionOffset[s] = at;
+        header.sectionBytes[s] = sizes[s];
+        at = (at + sizes[s] + ROSTER_ALIGN - 1) & ~(uint64_t)(ROSTER_ALIGN - 1);
+    }
+    header.fileSize = at;
+
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", indexFile);
+    int fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("Error: Couldn't create '%s'.\n", temporary);
+        freeNameIndex(index);
+        return 1;
+    }
+    static const char padding[ROSTER_ALIGN];
+    int failed = writeAll(fd, (const char*)&header, sizeof(header));
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < ROSTER_SECTIONS && !failed; s++) {
+        failed |= writeAll(fd, padding, header.sectionOffset[s] - written);
+        failed |= writeAll(fd, (const char*)*fields[s], sizes[s]);
+        written = header.sectionOffset[s] + sizes[s];
+    }
+    if (!failed) failed |= writeAll(fd, padding, header.fileSize - written);
+    if (!failed) failed |= fsync(fd);
+    //Check what actually landed on disk, so loads can trust it
+    if (!failed) {
+        NameIndex* compiled = mapRosterFile(fd, header.fileSize);
+        failed |= compiled == NULL || !validRoster(compiled);
+        freeNameIndex(compiled);
+    }
+    failed |= close(fd);
+    if (!failed) failed |= rename(temporary, indexFile);
+    if (failed) {
+        printf("Error: Couldn't write '%s'.\n", indexFile);
+        unlink(temporary);
+    } else {
+        printf("Compiled %u names into '%s' (%.1f MB).\n", index->count, indexFile, header.fileSize / 1e6);
+    }
+    freeNameIndex(index);
+    return failed != 0;
+}
+
+//Where the loader reports progress and errors, stdout when NULL. Batch mode points it
+//at stderr so its stdout is nothing but results.
+static FILE* loaderMessages;
+
+//Bulk loader. The roster is mapped copy-on-write so lines can be terminated in place,
+//threads parse and sort a slice each, sorted slices are merged pairwise (also in parallel)
+//and the index is built from the final run in one pass. No per-name allocation or output.
+//A compiled roster is mapped by mapRosterFile instead.
+NameIndex* loadNamesFromFile(const char* filename) {
+    FILE* out = loaderMessages ? loaderMessages : stdout;
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        if (fd != -1) close(fd);
+        fprintf(out, "Error: Couldn't not open file '%s'. Make sure it really doest exist\n", filename);
+        return NULL;
+    }
+    size_t size = (size_t)info.st_size;
+    if (size == 0) {
+        close(fd);
+        return NULL;
+    }
+    char magic[sizeof(ROSTER_MAGIC) - 1];
+    if (pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) && memcmp(magic, ROSTER_MAGIC, sizeof(magic)) == 0) {
+        NameIndex* index = mapRosterFile(fd, size);
+        close(fd);
+        if (index == NULL) fprintf(out, "Error: '%s' is damaged or isn't a roster this build can use, compile it again.\n", filename);
+        else fprintf(out, "Mapped compiled roster '%s' (%u names) in %.2f ms.\n", filename, index->count, elapsedMs(&started));
+        return index;
+    }
+    char* data = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(out, "Error: Couldn't map '%s'.\n", filename);
+        return NULL;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    fprintf(out, "Loading names from '%s'...\n", filename);
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = size / MIN_CHUNK_BYTES + 1;
+    if (threads > (size_t)(cores > 0 ? cores : 1)) threads = cores > 0 ? cores : 1;
+    if (threads > MAX_LOAD_THREADS) threads = MAX_LOAD_THREADS;
+
+    //A final line with no newline has no byte to terminate it in, copy it out first
+    size_t lineStart = size;
+    while (lineStart > 0 && data[lineStart - 1] != '\n') lineStart--;
+    size_t tailLength = size - lineStart;
+    char tail[MAX_NAME_LENGTH];
+    if (tailLength > 0 && data[size - 1] == '\r') tailLength--;
+    if (tailLength > MAX_NAME_LENGTH - 1) tailLength = MAX_NAME_LENGTH - 1;
+    memcpy(tail, data + lineStart, tailLength);
+    tail[tailLength] = '\0';
+
+    //Split points are moved to the next line start before any thread writes a NUL
+    LoadChunk chunks[MAX_LOAD_THREADS + 1];
+    pthread_t workers[MAX_LOAD_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    for (size_t t = 0; t < threads; t++) {
+        size_t start = size * t / threads;
+        while (start > 0 && start < size && data[start - 1] != '\n') start++;
+        chunks[t].data = data;
+        chunks[t].size = size;
+        chunks[t].start = start;
+        if (t > 0) chunks[t - 1].end = start;
+    }
+    chunks[threads - 1].end = size;
+    for (size_t t = 1; t < threads; t++) {
+        if (pthread_create(&workers[t], NULL, parseChunk, &chunks[t]) != 0) {
+            workers[t] = pthread_self();
+            parseChunk(&chunks[t]);
+        }
+    }
+    parseChunk(&chunks[0]);
+    for (size_t t = 1; t < threads; t++) {
+        if (!pthread_equal(workers[t], pthread_self())) pthread_join(workers[t], NULL);
+    }
+
+    //The unterminated last line gets its own little run
+    size_t runs = threads;
+    if (tailLength > 0 && (chunks[runs].names = (char**)malloc(sizeof(char*))) != NULL) {
+        chunks[runs].names[0] = tail;
+        chunks[runs].count = chunks[runs].lines = 1;
+        runs++;
+    }
+
+    char** owned[MAX_LOAD_THREADS + 1];
+    size_t ownedCount = runs;
+    size_t total = 0;
+    size_t lines = 0;
+    for (size_t r = 0; r < runs; r++) {
+        owned[r] = chunks[r].names;
+        total += chunks[r].count;
+        lines += chunks[r].lines;
+    }
+
+    //Merge rounds ping-pong between two buffers, each round halves the number of runs
+    char** buffers[2] = { NULL, NULL };
+    for (int round = 0; runs > 1; round++) {
+        char** target = buffers[round % 2];
+        if (target == NULL) target = buffers[round % 2] = (char**)malloc(total * sizeof(char*));
+        if (target == NULL) break;
+
+        MergeJob jobs[(MAX_LOAD_THREADS + 2) / 2];
+        size_t pairs = runs / 2;
+        size_t offset = 0;
+        for (size_t p = 0; p < pairs; p++) {
+            jobs[p].left = &chunks[2 * p];
+            jobs[p].right = &chunks[2 * p + 1];
+            jobs[p].merged = target + offset;
+            offset += chunks[2 * p].count + chunks[2 * p + 1].count;
+        }
+        for (size_t p = 1; p < pairs; p++) {
+            if (pthread_create(&workers[p], NULL, mergeChunks, &jobs[p]) != 0) {
+                workers[p] = pthread_self();
+                mergeChunks(&jobs[p]);
+            }
+        }
+        mergeChunks(&jobs[0]);
+        for (size_t p = 1; p < pairs; p++) {
+            if (!pthread_equal(workers[p], pthread_self())) pthread_join(workers[p], NULL);
+        }
+
+        //Odd run out is copied along, next round overwrites the buffer it was in
+        if (runs % 2) {
+            memcpy(target + offset, chunks[runs - 1].names, chunks[runs - 1].count * sizeof(char*));
+            chunks[pairs].names = target + offset;
+            chunks[pairs].count = chunks[runs - 1].count;
+        }
+        for (size_t p = 0; p < pairs; p++) {
+            chunks[p].names = jobs[p].merged;
+            chunks[p].count = jobs[p].count;
+        }
+        runs = pairs + runs % 2;
+    }
+
+    NameIndex* index = NULL;
+    if (runs == 1 && chunks[0].count > 0 && chunks[0].count <= UINT32_MAX) {
+        index = buildNameIndex(chunks[0].names, (uint32_t)chunks[0].count);
+    }
+    for (size_t r = 0; r < ownedCount; r++) free(owned[r]);
+    free(buffers[0]);
+    free(buffers[1]);
+    munmap(data, size);
+
+    if (index != NULL) {
+        fprintf(out, "Successfully loaded %zu names (%u unique) in %.1f ms using %zu thread(s).\n",
+               lines, index->count, elapsedMs(&started), threads);
+    }
+    return index;
 }
 
 // Display menu options
 void displayMenu() {
     printf("\n!!!!! Binary Access Control System !!!!!\n");
     printf("1. Request Access\n");
-    printf("2. Display Authorized Names (BST)\n");
+    printf("2. Display Authorized Names (balanced BST)\n");
     printf("3. Exit\n");
     printf("Choose an option (1-3): ");
 }
 
-//Access request from user
-void processAccessRequest(TreeNode* root) {
+//The decision behind every access request. A miss looks for the closest name within
+//MAX_SUGGESTION_DISTANCE and comes back as ACCESS_SUGGESTED if there is one.
+int checkAccess(const NameIndex* index, const char* name, char* suggestion, int* distance) {
+    if (dawgContains(index, name)) return ACCESS_GRANTED;
+    suggestion[0] = '\0';
+    *distance = MAX_SUGGESTION_DISTANCE;
+    findClosestMatch(index, name, suggestion, distance);
+    return suggestion[0] != '\0' && *distance > 0 ? ACCESS_SUGGESTED : ACCESS_DENIED;
+}
+
+void processAccessRequest(void) {
     char input[MAX_NAME_LENGTH];
     
     printf("\nEnter your name: ");
@@ -199,18 +1758,16 @@ void processAccessRequest(TreeNode* root) {
     
     printf("Processing: '%s'\n", input);
     
-    TreeNode* result = searchBST(root, input);
-    if (result != NULL) {
-        printf("ACCESS GRANTED, %s!\n", result->name);
+    char bestMatch[MAX_NAME_LENGTH];
+    int bestDistance;
+    int outcome = checkAccess(pinIndex(), input, bestMatch, &bestDistance);
+    unpinIndex();
+    if (outcome == ACCESS_GRANTED) {
+        printf("ACCESS GRANTED, %s!\n", input);
         return;
     }
     
-    char bestMatch[MAX_NAME_LENGTH] = "";
-    int bestDistance = INT_MAX;
-    
-    findClosestMatch(root, input, bestMatch, &bestDistance);
-    
-    if (bestDistance <= 3 && bestDistance > 0) { 
+    if (outcome == ACCESS_SUGGESTED) { 
         printf("ACCESS DENIED!!!\n");
         printf("💡 Did you mean: %s? (Levenshtein distance: %d)\n", bestMatch, bestDistance);
     } else {
@@ -223,30 +1780,360 @@ void processAccessRequest(TreeNode* root) {
 }
 
 //Print BST like an actual tree
-void printTree(TreeNode* root, int space) {
-    if (root == NULL) return;
+void printTree(const NameList* list, uint32_t slot, int space) {
+    if (slot >= list->count) return;
     
     //Increasing distance between levels
     space += 5;
     
-    printTree(root->right, space);
+    printTree(list, 2 * slot + 2, space);
     
     printf("\n");
     for (int i = 5; i < space; i++) {
         printf(" ");
     }
-    printf("%s\n", root->name);
+    printf("%s\n", indexName(list, slot));
     
     //Process the left child LAST
-    printTree(root->left, space);
+    printTree(list, 2 * slot + 1, space);
+}
+
+static double nowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
 }
 
-int main() {
-    TreeNode* root = NULL;
+//Microbenchmark: every roster name gets a typo (swap, drop or add a letter) and is scored
+//against the roster with the old matrix version, the bit-parallel kernel, and the kernel
+//with the suggestion cutoff. Then whole suggestions with every search there is, each one
+//checked against the full scan.
+int runDistanceBenchmark(const char* filename) {
+    NameIndex* index = loadNamesFromFile(filename);
+    if (index == NULL) return 1;
+    //The scan needs the names spelled out
+    NameList* list = listNames(index);
+    uint32_t names = index->count < 200 ? index->count : 200;
+    char (*queries)[MAX_NAME_LENGTH] = (char (*)[MAX_NAME_LENGTH])malloc(names * sizeof(*queries));
+    if (list == NULL || queries == NULL) {
+        free(queries);
+        freeNameList(list);
+        freeNameIndex(index);
+        return 1;
+    }
+    for (uint32_t q = 0; q < names; q++) {
+        const char* name = indexName(list, q);
+        size_t length = strlen(name);
+        size_t at = length / 2;
+        strcpy(queries[q], name);
+        if (q % 3 == 0) queries[q][at] = queries[q][at] == 'x' ? 'y' : 'x';
+        else if (q % 3 == 1) memmove(queries[q] + at, queries[q] + at + 1, length - at);
+        else if (length < MAX_NAME_LENGTH - 1) {
+            memmove(queries[q] + at + 1, queries[q] + at, length - at + 1);
+            queries[q][at] = 'e';
+        }
+    }
+
+    long mismatches = 0;
+    for (uint32_t q = 0; q < names; q++) {
+        for (uint32_t n = 0; n < names; n++) {
+            int expected = levenshteinDistanceMatrix(queries[q], indexName(list, n));
+            int bounded = boundedLevenshtein(queries[q], indexName(list, n), MAX_SUGGESTION_DISTANCE);
+            if (levenshteinDistance(queries[q], indexName(list, n)) != expected ||
+                bounded != (expected > MAX_SUGGESTION_DISTANCE ? MAX_SUGGESTION_DISTANCE + 1 : expected)) {
+                mismatches++;
+            }
+        }
+    }
+
+    int rounds = (int)(BENCH_PAIRS / ((uint64_t)names * names));
+    if (rounds < 1) rounds = 1;
+    double pairs = (double)rounds * names * names;
+    volatile long sink = 0;
+    const char* labels[3] = { "matrix (old)", "bit-parallel", "bit-parallel, k<=3" };
+    double timings[3];
+    for (int variant = 0; variant < 3; variant++) {
+        double started = nowMs();
+        for (int r = 0; r < rounds; r++) {
+            for (uint32_t q = 0; q < names; q++) {
+                for (uint32_t n = 0; n < names; n++) {
+                    const char* name = indexName(list, n);
+                    if (variant == 0) sink += levenshteinDistanceMatrix(queries[q], name);
+                    else if (variant == 1) sink += levenshteinDistance(queries[q], name);
+                    else sink += boundedLevenshtein(queries[q], name, MAX_SUGGESTION_DISTANCE);
+                }
+            }
+        }
+        timings[variant] = (nowMs() - started) * 1e6 / pairs;
+    }
+
+    printf("Edit distance benchmark, %u queries x %u names x %d rounds\n", names, names, rounds);
+    for (int variant = 0; variant < 3; variant++) {
+        printf("%-20s %8.1f ns/pair  (%.1fx)\n", labels[variant], timings[variant], timings[0] / timings[variant]);
+    }
+    printf("Mismatches against the matrix version: %ld\n", mismatches);
+
+    //Whole suggestions: every search against the full scan, same answers expected
+    uint32_t suggestions = names;
+    if ((uint64_t)suggestions * index->count > BENCH_PAIRS) suggestions = (uint32_t)(BENCH_PAIRS / index->count) + 1;
+    //Kernels the CPU can't run fall back, so only list the ones that are really different
+    const char* kernels[3] = { "scalar", "sse2", "avx2" };
+    const char* methods[5] = { "full scan", "DAWG automaton", "blocks, scalar", "blocks, sse2", "blocks, avx2" };
+    int methodCount = 2;
+    for (int k = 0; k < 3; k++) {
+        if (strcmp(selectBlockScorer(kernels[k]), kernels[k]) == 0) methods[methodCount++] = methods[2 + k];
+    }
+    long differences = 0;
+    printf("Suggestions for %u queries over %u names:\n", suggestions, index->count);
+    for (int m = 0; m < methodCount; m++) {
+        if (m >= 2) selectBlockScorer(methods[m] + strlen("blocks, "));
+        uint64_t work = 0;
+        double elapsed = 0;
+        for (uint32_t q = 0; q < suggestions; q++) {
+            char scanMatch[MAX_NAME_LENGTH] = "", match[MAX_NAME_LENGTH] = "";
+            int scanDistance = MAX_SUGGESTION_DISTANCE, distance = MAX_SUGGESTION_DISTANCE;
+            double started = nowMs();
+            if (m == 0) scanClosestMatch(list, queries[q], match, &distance);
+            else if (m == 1) work += dawgClosestMatch(index, queries[q], match, &distance);
+            else work += blockClosestMatch(index, queries[q], match, &distance);
+            elapsed += nowMs() - started;
+            if (m == 0) continue;
+            scanClosestMatch(list, queries[q], scanMatch, &scanDistance);
+            if (strcmp(scanMatch, match) != 0 || (scanMatch[0] && scanDistance != distance)) differences++;
+        }
+        printf("%-20s %8.1f us/query", methods[m], elapsed * 1e3 / suggestions);
+        if (m == 1) printf("  (%.2f%% of edges followed)\n", 100.0 * work / suggestions / index->dawgEdges);
+        else printf("  (%.1f%% of names scored)\n", m == 0 ? 100.0 : 100.0 * work / suggestions / index->count);
+    }
+    size_t arenaBytes = list->offsets[list->count - 1] + strlen(indexName(list, list->count - 1)) + 1 +
+                        (size_t)list->count * sizeof(uint32_t);
+    void** fields[ROSTER_SECTIONS];
+    size_t sizes[ROSTER_SECTIONS];
+    rosterSections(index, fields, sizes);
+    size_t indexBytes = 0;
+    for (int s = 0; s < ROSTER_SECTIONS; s++) indexBytes += sizes[s];
+    printf("Index (DAWG of %u nodes, %u edges, and blocks): %.1f bytes/name, names spelled out: %.1f bytes/name\n",
+           index->dawgNodes, index->dawgEdges, (double)indexBytes / index->count, (double)arenaBytes / list->count);
+    if (list->count != index->count) differences++;
+    for (uint32_t k = 0; k < list->count; k++) {
+        if (!dawgContains(index, indexName(list, k))) differences++;
+    }
+    for (uint32_t q = 0; q < names; q++) {
+        if (dawgContains(index, queries[q]) != (searchNames(list, queries[q]) != NULL)) differences++;
+    }
+    selectBlockScorer(NULL);
+    printf("Different answers: %ld\n", differences);
+    mismatches += differences;
+    free(queries);
+    freeNameList(list);
+    freeNameIndex(index);
+    return mismatches != 0;
+}
+
+static void checkBatch(BatchPool* round) {
+    size_t start;
+    while ((start = atomic_fetch_add_explicit(&round->next, BATCH_GRAIN, memory_order_relaxed)) < round->count) {
+        size_t end = start + BATCH_GRAIN < round->count ? start + BATCH_GRAIN : round->count;
+        for (size_t i = start; i < end; i++) {
+            AccessAttempt* attempt = &round->attempts[i];
+            if (attempt->outcome == ACCESS_INVALID) continue;
+            struct timespec began, done;
+            int distance = 0;
+            clock_gettime(CLOCK_MONOTONIC, &began);
+            attempt->outcome = (uint8_t)checkAccess(round->index, attempt->name, attempt->suggestion, &distance);
+            clock_gettime(CLOCK_MONOTONIC, &done);
+            attempt->distance = (uint8_t)distance;
+            int64_t ns = (int64_t)(done.tv_sec - began.tv_sec) * 1000000000 + (done.tv_nsec - began.tv_nsec);
+            attempt->latencyNs = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+        }
+    }
+}
+
+static void* batchWorker(void* arg) {
+    BatchPool* pool = (BatchPool*)arg;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->round == seen && !pool->stopping) pthread_cond_wait(&pool->posted, &pool->lock);
+        if (pool->stopping) break;
+        seen = pool->round;
+        pthread_mutex_unlock(&pool->lock);
+        checkBatch(pool);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static int recordLatency(LatencyLog* log, uint32_t ns) {
+    if (log->count == log->capacity) {
+        size_t capacity = log->capacity ? log->capacity * 2 : 4096;
+        uint32_t* grown = (uint32_t*)realloc(log->ns, capacity * sizeof(uint32_t));
+        if (grown == NULL) return -1;
+        log->ns = grown;
+        log->capacity = capacity;
+    }
+    log->ns[log->count++] = ns;
+    return 0;
+}
+
+static int compareLatencies(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void reportLatencies(const char* label, LatencyLog* log) {
+    if (log->count == 0) {
+        fprintf(stderr, "  %-24s%10zu\n", label, log->count);
+        return;
+    }
+    qsort(log->ns, log->count, sizeof(uint32_t), compareLatencies);
+    size_t last = log->count - 1;
+    fprintf(stderr, "  %-24s%10zu%10.1f%10.1f%10.1f%10.1f us\n", label, log->count,
+           log->ns[last * 50 / 100] / 1e3, log->ns[last * 90 / 100] / 1e3,
+           log->ns[last * 99 / 100] / 1e3, log->ns[last] / 1e3);
+}
+
+//Batch mode: checks every name in attemptsFile (one per line, "-" for stdin) against
+//the roster on a pool of threads sharing the read-only index. Results come out in
+//input order as tab separated lines: GRANTED name, DENIED name suggestion distance,
+//DENIED name, or INVALID and the first MAX_NAME_LENGTH - 1 characters of a line too
+//long to be any roster name, which is never matched. The throughput, per-outcome
+//latency percentiles and any loader messages go to stderr. This is for replaying door
+//logs, so nothing goes to the audit log.
+int runBatchCheck(const char* namesFile, const char* attemptsFile, long threads) {
+    FILE* input = strcmp(attemptsFile, "-") == 0 ? stdin : fopen(attemptsFile, "r");
+    if (input == NULL) {
+        fprintf(stderr, "Error: Couldn't open '%s'.\n", attemptsFile);
+        return 1;
+    }
+    loaderMessages = stderr;
+    NameIndex* index = loadNamesFromFile(namesFile);
+    AccessAttempt* attempts = (AccessAttempt*)malloc(BATCH_ROUND * sizeof(AccessAttempt));
+    if (index == NULL || attempts == NULL) {
+        if (input != stdin) fclose(input);
+        freeNameIndex(index);
+        free(attempts);
+        return 1;
+    }
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > MAX_BATCH_THREADS) threads = MAX_BATCH_THREADS;
+
+    BatchPool pool = { .index = index, .attempts = attempts, .lock = PTHREAD_MUTEX_INITIALIZER,
+                       .posted = PTHREAD_COND_INITIALIZER, .finished = PTHREAD_COND_INITIALIZER };
+    atomic_init(&pool.next, 0);
+    //This thread works every round too, so it counts as one of them
+    pthread_t workers[MAX_BATCH_THREADS];
+    long started = 0;
+    while (started < threads - 1 && pthread_create(&workers[started], NULL, batchWorker, &pool) == 0) started++;
+    if (started < threads - 1) {
+        fprintf(stderr, "Warning: Couldn't start every batch thread, using %ld.\n", started + 1);
+        threads = started + 1;
+    }
+
+    LatencyLog latencies[3];
+    memset(latencies, 0, sizeof(latencies));
+    char* line = NULL;
+    size_t lineCapacity = 0;
+    size_t total = 0;
+    size_t invalid = 0;
+    int failed = 0;
+    double checking = 0;
+    int more = 1;
+    while (more && !failed) {
+        size_t count = 0;
+        while (count < BATCH_ROUND) {
+            ssize_t length = getline(&line, &lineCapacity, input);
+            if (length < 0) {
+                more = 0;
+                break;
+            }
+            while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) length--;
+            if (length == 0) continue;
+            AccessAttempt* attempt = &attempts[count++];
+            attempt->outcome = ACCESS_GRANTED;
+            if (length > MAX_NAME_LENGTH - 1) {
+                //Cut short it could match a roster name it isn't
+                attempt->outcome = ACCESS_INVALID;
+                length = MAX_NAME_LENGTH - 1;
+            }
+            memcpy(attempt->name, line, (size_t)length);
+            attempt->name[length] = '\0';
+        }
+        if (count == 0) break;
+
+        double began = nowMs();
+        pthread_mutex_lock(&pool.lock);
+        pool.count = count;
+        atomic_store_explicit(&pool.next, 0, memory_order_relaxed);
+        pool.busy = (int)started;
+        pool.round++;
+        pthread_cond_broadcast(&pool.posted);
+        pthread_mutex_unlock(&pool.lock);
+        checkBatch(&pool);
+        pthread_mutex_lock(&pool.lock);
+        while (pool.busy > 0) pthread_cond_wait(&pool.finished, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+        checking += nowMs() - began;
+
+        for (size_t i = 0; i < count; i++) {
+            AccessAttempt* attempt = &attempts[i];
+            if (attempt->outcome == ACCESS_GRANTED) printf("GRANTED\t%s\n", attempt->name);
+            else if (attempt->outcome == ACCESS_SUGGESTED) printf("DENIED\t%s\t%s\t%d\n", attempt->name, attempt->suggestion, attempt->distance);
+            else if (attempt->outcome == ACCESS_DENIED) printf("DENIED\t%s\n", attempt->name);
+            else printf("INVALID\t%s\n", attempt->name);
+            if (attempt->outcome == ACCESS_INVALID) invalid++;
+            else failed |= recordLatency(&latencies[attempt->outcome], attempt->latencyNs);
+        }
+        total += count;
+    }
+    free(line);
+    if (input != stdin) fclose(input);
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = 1;
+    pthread_cond_broadcast(&pool.posted);
+    pthread_mutex_unlock(&pool.lock);
+    for (long t = 0; t < started; t++) pthread_join(workers[t], NULL);
+
+    if (failed) {
+        fprintf(stderr, "Error: Out of memory for the latency log.\n");
+    } else {
+        fprintf(stderr, "Checked %zu attempts in %.1f ms using %ld thread(s): %.0f requests/s\n",
+               total, checking, threads, checking > 0 ? total * 1e3 / checking : 0.0);
+        fprintf(stderr, "  %-24s%10s%10s%10s%10s%10s\n", "outcome", "count", "p50", "p90", "p99", "max");
+        reportLatencies("granted", &latencies[ACCESS_GRANTED]);
+        reportLatencies("denied, suggestion", &latencies[ACCESS_SUGGESTED]);
+        reportLatencies("denied, no suggestion", &latencies[ACCESS_DENIED]);
+        if (invalid > 0) fprintf(stderr, "  %-24s%10zu\n", "invalid, too long", invalid);
+    }
+    for (int i = 0; i < 3; i++) free(latencies[i].ns);
+    free(attempts);
+    freeNameIndex(index);
+    return failed;
+}
+
+int main(int argc, char* argv[]) {
+    const char* kernel = selectBlockScorer(NULL);
+    if (argc == 3 && strcmp(argv[1], "--bench-distance") == 0) return runDistanceBenchmark(argv[2]);
+    if (argc == 4 && strcmp(argv[1], "--compile") == 0) return compileRoster(argv[2], argv[3]);
+    if (argc == 3 && strcmp(argv[1], "--verify") == 0) return verifyRoster(argv[2]);
+    if (argc >= 3 && argc <= 5 && strcmp(argv[1], "--batch") == 0) {
+        return runBatchCheck(argv[2], argc > 3 ? argv[3] : "-", argc > 4 ? atol(argv[4]) : 0);
+    }
+    if (argc != 1) {
+        printf("Usage: %s [--bench-distance NAMES_FILE | --batch NAMES_FILE [ATTEMPTS_FILE|-] [THREADS] |\n"
+               "        --compile NAMES_FILE INDEX_FILE | --verify INDEX_FILE]\n"
+               "Anywhere a names file goes, a compiled index file can go instead.\n", argv[0]);
+        return 1;
+    }
+
+    NameIndex* index = NULL;
     char filename[100];
     int choice;
     
-    printf("SYSTEM IS STARTING\n");
+    printf("SYSTEM IS STARTING (suggestion kernel: %s)\n", kernel);
     printf("Enter the filename containing authorized names: ");
     
     if (fgets(filename, sizeof(filename), stdin) == NULL) {
@@ -257,11 +2144,13 @@ int main() {
     filename[strcspn(filename, "\n")] = '\0';
     
     //Loading names from file
-    root = loadNamesFromFile(filename);
-    if (root == NULL) {
+    index = loadNamesFromFile(filename);
+    if (index == NULL) {
         printf("Failing to load names...oh well exiting.\n");
         return 1;
     }
+    if (startRosterWatcher(filename, index) != 0) printf("Warning: couldn't watch '%s', changes need a restart\n", filename);
+    if (startAuditLog(UNKNOWN_NAMES_FILE) != 0) printf("Warning: couldn't open %s, unknown names won't be logged\n", UNKNOWN_NAMES_FILE);
     
     //Loop through main program to do once again when done.
     while (1) {
@@ -277,21 +2166,31 @@ int main() {
         
         switch (choice) {
             case 1:
-                processAccessRequest(root);
+                processAccessRequest();
                 break;
-            case 2:
+            case 2: {
+                NameList* list = listNames(pinIndex());
+                unpinIndex();
+                if (list == NULL) {
+                    printf("Error: Out of memory listing names.\n");
+                    break;
+                }
                 printf("\nNames, BST Structure:\n");
-                printTree(root, 0);
+                printTree(list, 0, 0);
+                freeNameList(list);
                 break;
+            }
             case 3:
                 printf("Goodbye!\n");
-                freeBST(root);
+                stopAuditLog();
+                stopRosterWatcher();
                 return 0;
             default:
                 printf("Invalid choice. Please select 1, 2, or 3.\n");
         }
     }
     //Mandatory freeing again
-    freeBST(root);
+    stopAuditLog();
+    stopRosterWatcher();
     return 0;
 }
\ No newline at end of file
@@ -2,9 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
 
-#define MAX_DEVICES 100
 #define DEVICE_ID_LENGTH 5
+#define INITIAL_DEVICES 16
+#define INITIAL_EDGES 4
+#define INITIAL_ID_SLOTS 32 //power of two
 
 //Business as usual, Strucs are delusional.
 typedef struct {
@@ -12,62 +15,340 @@ typedef struct {
     int index;
 } Device;
 
-//Struc for preliminary devices.
+//One end of a connection. A bidirectional link is two edges, both flagged.
 typedef struct {
-    Device devices[MAX_DEVICES];
-    int adjacency_matrix[MAX_DEVICES][MAX_DEVICES];
-    int bidirectional[MAX_DEVICES][MAX_DEVICES];
+    int device;
+    int bidirectional;
+} Edge;
+
+//Growable edge list, one per device and direction.
+typedef struct {
+    Edge *edges;
+    int count;
+    int capacity;
+} EdgeList;
+
+//Sparse suits big networks with few links per device. Bitset is a matrix again but one
+//bit per edge, for dense sub-networks where rows of 64 devices at a time can be ANDed,
+//ORed and popcounted.
+typedef enum {
+    GRAPH_SPARSE,
+    GRAPH_BITSET
+} GraphBackend;
+
+//Struc for preliminary devices. Everything grows with the network, no device cap.
+//Sparse: changes go to the per device edge lists. Queries read a compacted CSR copy
+//instead: every device's edges back to back in one array, sorted by device index,
+//rebuilt on the first query after a change.
+//Bitset: row i bit j of adjacency_bits is the edge i -> j. Bidirectional links get
+//their own bitset, i -> j plus j -> i added separately aren't one.
+typedef struct {
+    GraphBackend backend;
+    Device *devices;
     int device_count;
+    int device_capacity;
+    int edge_count;       //directed edges
+    EdgeList *outgoing;   //outgoing[i]: edges i -> j, device = j
+    EdgeList *incoming;   //incoming[j]: edges i -> j, device = i
+    int csr_dirty;
+    int *out_start;       //device i's outgoing edges are out_edges[out_start[i] .. out_start[i + 1]]
+    Edge *out_edges;
+    int *in_start;
+    Edge *in_edges;
+    uint64_t *adjacency_bits;     //device_capacity rows of row_words words
+    uint64_t *bidirectional_bits;
+    int row_words;
+    //Hash index from device ID to device index. IDs are at most 4 characters, packed into
+    //a 32 bit key; open addressing with linear probing, kept at most half full.
+    uint32_t *id_keys;
+    int *id_devices;      //-1 for an empty slot
+    int id_slots;
+    int id_shift;         //32 - log2(id_slots), for the multiplicative hash
 } Graph;
 
+//Walks one device's outgoing or incoming connections in device order, whichever the
+//backend. The graph must be compacted first.
+typedef struct {
+    Graph *g;
+    int device;
+    int incoming;
+    int at;               //CSR position, or for bitsets the next device to look at
+    int end;
+} ConnectionCursor;
+
 //Function Prototypes
-void initialize_graph(Graph *g);
+void initialize_graph(Graph *g, GraphBackend backend);
+void free_graph(Graph *g);
 int find_device_index(Graph *g, const char *device_id);
 int add_device(Graph *g, const char *device_id);
 void add_connection(Graph *g, const char *from, const char *to, int is_bidirectional);
+int compact_graph(Graph *g);
 void display_adjacency_matrix(Graph *g);
 void query_device_connections(Graph *g, const char *device_id);
 void display_all_connections(Graph *g, const char *device_id);
+void show_common_neighbours(Graph *g, const char *first, const char *second);
+void show_reachable_devices(Graph *g, const char *device_id, int hops);
 void remove_connection(Graph *g, const char *from, const char *to);
 void remove_device(Graph *g, const char *device_id);
 void print_menu();
 
-void initialize_graph(Graph *g) {
-    g->device_count = 0;
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        for (int j = 0; j < MAX_DEVICES; j++) {
-            g->adjacency_matrix[i][j] = 0;
-            g->bidirectional[i][j] = 0;
-        }
+void initialize_graph(Graph *g, GraphBackend backend) {
+    memset(g, 0, sizeof(*g));
+    g->backend = backend;
+    g->csr_dirty = 1;
+}
+
+void free_graph(Graph *g) {
+    for (int i = 0; g->outgoing != NULL && i < g->device_count; i++) {
+        free(g->outgoing[i].edges);
+        free(g->incoming[i].edges);
     }
+    free(g->devices);
+    free(g->outgoing);
+    free(g->incoming);
+    free(g->out_start);
+    free(g->out_edges);
+    free(g->in_start);
+    free(g->in_edges);
+    free(g->adjacency_bits);
+    free(g->bidirectional_bits);
+    free(g->id_keys);
+    free(g->id_devices);
+    initialize_graph(g, g->backend);
 }
 
+static uint64_t *bit_row(Graph *g, uint64_t *bits, int row) {
+    return bits + (size_t)row * g->row_words;
+}
 
-//Device ordering and numeric attachement
-int find_device_index(Graph *g, const char *device_id) {
+static int test_bit(Graph *g, uint64_t *bits, int row, int column) {
+    return (bit_row(g, bits, row)[column >> 6] >> (column & 63)) & 1;
+}
+
+static void set_bit(Graph *g, uint64_t *bits, int row, int column) {
+    bit_row(g, bits, row)[column >> 6] |= 1ULL << (column & 63);
+}
+
+static void clear_bit(Graph *g, uint64_t *bits, int row, int column) {
+    bit_row(g, bits, row)[column >> 6] &= ~(1ULL << (column & 63));
+}
+
+//Bitsets sized for capacity devices, existing rows copied over
+static int grow_bitsets(Graph *g, int capacity) {
+    int row_words = (capacity + 63) / 64;
+    uint64_t *adjacency = calloc((size_t)capacity * row_words, sizeof(uint64_t));
+    uint64_t *bidirectional = calloc((size_t)capacity * row_words, sizeof(uint64_t));
+    if (adjacency == NULL || bidirectional == NULL) {
+        free(adjacency);
+        free(bidirectional);
+        return -1;
+    }
+    for (int i = 0; i < g->device_count; i++) {
+        memcpy(adjacency + (size_t)i * row_words, bit_row(g, g->adjacency_bits, i), g->row_words * sizeof(uint64_t));
+        memcpy(bidirectional + (size_t)i * row_words, bit_row(g, g->bidirectional_bits, i), g->row_words * sizeof(uint64_t));
+    }
+    free(g->adjacency_bits);
+    free(g->bidirectional_bits);
+    g->adjacency_bits = adjacency;
+    g->bidirectional_bits = bidirectional;
+    g->row_words = row_words;
+    return 0;
+}
+
+//Room for one more device, doubling the arrays when full
+static int reserve_device(Graph *g) {
+    if (g->device_count < g->device_capacity) return 0;
+    int capacity = g->device_capacity ? g->device_capacity * 2 : INITIAL_DEVICES;
+    Device *devices = realloc(g->devices, capacity * sizeof(Device));
+    if (devices == NULL) return -1;
+    g->devices = devices;
+    if (g->backend == GRAPH_BITSET) {
+        if (grow_bitsets(g, capacity) != 0) return -1;
+    } else {
+        EdgeList *outgoing = realloc(g->outgoing, capacity * sizeof(EdgeList));
+        if (outgoing == NULL) return -1;
+        g->outgoing = outgoing;
+        EdgeList *incoming = realloc(g->incoming, capacity * sizeof(EdgeList));
+        if (incoming == NULL) return -1;
+        g->incoming = incoming;
+    }
+    g->device_capacity = capacity;
+    return 0;
+}
+
+static Edge *find_edge(EdgeList *list, int device) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->edges[i].device == device) return &list->edges[i];
+    }
+    return NULL;
+}
+
+static int append_edge(EdgeList *list, int device, int bidirectional) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : INITIAL_EDGES;
+        Edge *edges = realloc(list->edges, capacity * sizeof(Edge));
+        if (edges == NULL) return -1;
+        list->edges = edges;
+        list->capacity = capacity;
+    }
+    list->edges[list->count].device = device;
+    list->edges[list->count].bidirectional = bidirectional;
+    list->count++;
+    return 0;
+}
+
+//Order within a list doesn't matter, the CSR copy is sorted when it's built
+static int drop_edge(EdgeList *list, int device) {
+    Edge *edge = find_edge(list, device);
+    if (edge == NULL) return 0;
+    *edge = list->edges[--list->count];
+    return 1;
+}
+
+//0 for no edge from -> to, 1 for a one way one, 2 for part of a bidirectional link
+static int edge_state(Graph *g, int from, int to) {
+    if (g->backend == GRAPH_BITSET) {
+        if (!test_bit(g, g->adjacency_bits, from, to)) return 0;
+        return test_bit(g, g->bidirectional_bits, from, to) ? 2 : 1;
+    }
+    Edge *edge = find_edge(&g->outgoing[from], to);
+    if (edge == NULL) return 0;
+    return edge->bidirectional ? 2 : 1;
+}
+
+//Adds from -> to, or just marks it bidirectional if it's already there
+static int set_edge(Graph *g, int from, int to, int is_bidirectional) {
+    if (g->backend == GRAPH_BITSET) {
+        if (!test_bit(g, g->adjacency_bits, from, to)) g->edge_count++;
+        set_bit(g, g->adjacency_bits, from, to);
+        if (is_bidirectional) set_bit(g, g->bidirectional_bits, from, to);
+        return 0;
+    }
+    Edge *edge = find_edge(&g->outgoing[from], to);
+    if (edge != NULL) {
+        edge->bidirectional |= is_bidirectional;
+        find_edge(&g->incoming[to], from)->bidirectional |= is_bidirectional;
+        return 0;
+    }
+    if (append_edge(&g->outgoing[from], to, is_bidirectional) != 0) return -1;
+    if (append_edge(&g->incoming[to], from, is_bidirectional) != 0) {
+        g->outgoing[from].count--;
+        return -1;
+    }
+    g->edge_count++;
+    return 0;
+}
+
+static void clear_edge(Graph *g, int from, int to) {
+    if (g->backend == GRAPH_BITSET) {
+        if (test_bit(g, g->adjacency_bits, from, to)) g->edge_count--;
+        clear_bit(g, g->adjacency_bits, from, to);
+        clear_bit(g, g->bidirectional_bits, from, to);
+    } else if (drop_edge(&g->outgoing[from], to)) {
+        drop_edge(&g->incoming[to], from);
+        g->edge_count--;
+    }
+}
+
+//"D001" and the like fit in 32 bits, the key is just the characters
+static uint32_t pack_device_id(const char *device_id) {
+    unsigned char packed[DEVICE_ID_LENGTH - 1] = {0};
+    for (int i = 0; i < DEVICE_ID_LENGTH - 1 && device_id[i] != '\0'; i++) {
+        packed[i] = (unsigned char)device_id[i];
+    }
+    uint32_t key;
+    memcpy(&key, packed, sizeof(key));
+    return key;
+}
+
+//Where key sits in the index, or the empty slot it would go in
+static int id_slot(Graph *g, uint32_t key) {
+    int slot = (int)((key * 2654435769u) >> g->id_shift);
+    while (g->id_devices[slot] != -1 && g->id_keys[slot] != key) {
+        slot = (slot + 1) & (g->id_slots - 1);
+    }
+    return slot;
+}
+
+//Doubles the index when adding one more device would make it over half full
+static int reserve_id_slot(Graph *g) {
+    if ((g->device_count + 1) * 2 <= g->id_slots) return 0;
+    int slots = g->id_slots ? g->id_slots * 2 : INITIAL_ID_SLOTS;
+    uint32_t *keys = malloc(slots * sizeof(uint32_t));
+    int *devices = malloc(slots * sizeof(int));
+    if (keys == NULL || devices == NULL) {
+        free(keys);
+        free(devices);
+        return -1;
+    }
+    free(g->id_keys);
+    free(g->id_devices);
+    g->id_keys = keys;
+    g->id_devices = devices;
+    g->id_slots = slots;
+    g->id_shift = 32;
+    while ((1 << (32 - g->id_shift)) < slots) g->id_shift--;
+    for (int slot = 0; slot < slots; slot++) g->id_devices[slot] = -1;
     for (int i = 0; i < g->device_count; i++) {
-        if (strcmp(g->devices[i].id, device_id) == 0) {
-            return i;
+        int slot = id_slot(g, pack_device_id(g->devices[i].id));
+        g->id_keys[slot] = pack_device_id(g->devices[i].id);
+        g->id_devices[slot] = i;
+    }
+    return 0;
+}
+
+//Empties key's slot and moves later entries of the same run back into the gap, so
+//lookups never need tombstones
+static void unindex_device(Graph *g, uint32_t key) {
+    int mask = g->id_slots - 1;
+    int gap = id_slot(g, key);
+    if (g->id_devices[gap] == -1) return;
+    for (int slot = (gap + 1) & mask; g->id_devices[slot] != -1; slot = (slot + 1) & mask) {
+        int home = (int)((g->id_keys[slot] * 2654435769u) >> g->id_shift);
+        //Movable unless its home lies cyclically in (gap, slot]
+        if (((slot - home) & mask) >= ((slot - gap) & mask)) {
+            g->id_keys[gap] = g->id_keys[slot];
+            g->id_devices[gap] = g->id_devices[slot];
+            gap = slot;
         }
     }
-    return -1;
+    g->id_devices[gap] = -1;
+}
+
+//Device ordering and numeric attachement
+int find_device_index(Graph *g, const char *device_id) {
+    if (g->id_slots == 0) {
+        return -1;
+    }
+    return g->id_devices[id_slot(g, pack_device_id(device_id))];
 }
 
 //Once device index known. add it.
 int add_device(Graph *g, const char *device_id) {
-    if (g->device_count >= MAX_DEVICES) {
-        printf("Error: Maximum device limit reached!\n");
-        return -1;
+    int existing = find_device_index(g, device_id);
+    if (existing != -1) {
+        return existing;
     }
     
-    if (find_device_index(g, device_id) != -1) {
-        return find_device_index(g, device_id);
+    if (reserve_device(g) != 0 || reserve_id_slot(g) != 0) {
+        printf("Error: Out of memory for devices!\n");
+        return -1;
     }
     
-    strcpy(g->devices[g->device_count].id, device_id);
-    g->devices[g->device_count].index = g->device_count;
+    int index = g->device_count;
+    snprintf(g->devices[index].id, DEVICE_ID_LENGTH, "%s", device_id);
+    g->devices[index].index = index;
+    uint32_t key = pack_device_id(device_id);
+    int slot = id_slot(g, key);
+    g->id_keys[slot] = key;
+    g->id_devices[slot] = index;
+    if (g->backend == GRAPH_SPARSE) {
+        memset(&g->outgoing[index], 0, sizeof(EdgeList));
+        memset(&g->incoming[index], 0, sizeof(EdgeList));
+    }
     g->device_count++;
-    return g->device_count - 1;
+    g->csr_dirty = 1;
+    return index;
 }
 
 void add_connection(Graph *g, const char *from, const char *to, int is_bidirectional) {
@@ -75,24 +356,145 @@ void add_connection(Graph *g, const char *from, const char *to, int is_bidirecti
     int to_index = add_device(g, to);
     
     if (from_index == -1 || to_index == -1) {
-        printf("Error: Cannot add connection - device limit reached.\n");
+        printf("Error: Cannot add connection - out of memory.\n");
         return;
     }
     
-    g->adjacency_matrix[from_index][to_index] = 1;
+    int failed = set_edge(g, from_index, to_index, is_bidirectional);
+    if (is_bidirectional && !failed) {
+        failed = set_edge(g, to_index, from_index, 1);
+    }
+    if (failed) {
+        printf("Error: Cannot add connection - out of memory.\n");
+    }
+    g->csr_dirty = 1;
+}
+
+//Rebuilds the CSR copy from the edge lists if anything changed since the last one.
+//Walking the sources in index order and dropping each edge into its target's row
+//leaves every incoming row sorted, and the same the other way round for outgoing,
+//so it's O(devices + edges) with no sorting. Bitsets are always ready.
+int compact_graph(Graph *g) {
+    if (!g->csr_dirty || g->backend == GRAPH_BITSET) return 0;
+    int devices = g->device_count;
+    int *out_start = realloc(g->out_start, (devices + 1) * sizeof(int));
+    if (out_start != NULL) g->out_start = out_start;
+    int *in_start = realloc(g->in_start, (devices + 1) * sizeof(int));
+    if (in_start != NULL) g->in_start = in_start;
+    Edge *out_edges = realloc(g->out_edges, (g->edge_count ? g->edge_count : 1) * sizeof(Edge));
+    if (out_edges != NULL) g->out_edges = out_edges;
+    Edge *in_edges = realloc(g->in_edges, (g->edge_count ? g->edge_count : 1) * sizeof(Edge));
+    if (in_edges != NULL) g->in_edges = in_edges;
+    int *cursor = malloc((devices ? devices : 1) * sizeof(int));
+    if (out_start == NULL || in_start == NULL || out_edges == NULL || in_edges == NULL || cursor == NULL) {
+        free(cursor);
+        printf("Error: Out of memory compacting the network.\n");
+        return -1;
+    }
+    
+    g->out_start[0] = g->in_start[0] = 0;
+    for (int i = 0; i < devices; i++) {
+        g->out_start[i + 1] = g->out_start[i] + g->outgoing[i].count;
+        g->in_start[i + 1] = g->in_start[i] + g->incoming[i].count;
+    }
     
-    if (is_bidirectional) {
-        g->adjacency_matrix[to_index][from_index] = 1;
-        g->bidirectional[from_index][to_index] = 1;
-        g->bidirectional[to_index][from_index] = 1;
+    memcpy(cursor, g->in_start, devices * sizeof(int));
+    for (int from = 0; from < devices; from++) {
+        for (int e = 0; e < g->outgoing[from].count; e++) {
+            Edge edge = g->outgoing[from].edges[e];
+            g->in_edges[cursor[edge.device]].device = from;
+            g->in_edges[cursor[edge.device]++].bidirectional = edge.bidirectional;
+        }
+    }
+    memcpy(cursor, g->out_start, devices * sizeof(int));
+    for (int to = 0; to < devices; to++) {
+        for (int e = 0; e < g->incoming[to].count; e++) {
+            Edge edge = g->incoming[to].edges[e];
+            g->out_edges[cursor[edge.device]].device = to;
+            g->out_edges[cursor[edge.device]++].bidirectional = edge.bidirectional;
+        }
+    }
+    free(cursor);
+    g->csr_dirty = 0;
+    return 0;
+}
+
+static void open_cursor(ConnectionCursor *cursor, Graph *g, int device, int incoming) {
+    cursor->g = g;
+    cursor->device = device;
+    cursor->incoming = incoming;
+    if (g->backend == GRAPH_BITSET) {
+        cursor->at = 0;
+        cursor->end = g->device_count;
+    } else if (incoming) {
+        cursor->at = g->in_start[device];
+        cursor->end = g->in_start[device + 1];
+    } else {
+        cursor->at = g->out_start[device];
+        cursor->end = g->out_start[device + 1];
     }
 }
 
+//Next connected device, -1 once there are none left
+static int next_connection(ConnectionCursor *cursor, int *bidirectional) {
+    Graph *g = cursor->g;
+    if (cursor->at >= cursor->end) return -1;
+    if (g->backend == GRAPH_SPARSE) {
+        Edge *edge = cursor->incoming ? &g->in_edges[cursor->at++] : &g->out_edges[cursor->at++];
+        *bidirectional = edge->bidirectional;
+        return edge->device;
+    }
+    
+    if (cursor->incoming) {
+        //A column, one bit per row
+        for (int i = cursor->at; i < cursor->end; i++) {
+            if (test_bit(g, g->adjacency_bits, i, cursor->device)) {
+                cursor->at = i + 1;
+                *bidirectional = test_bit(g, g->bidirectional_bits, i, cursor->device);
+                return i;
+            }
+        }
+        cursor->at = cursor->end;
+        return -1;
+    }
+    
+    //A row, skipping 64 devices at a time while the words are empty
+    uint64_t *row = bit_row(g, g->adjacency_bits, cursor->device);
+    int word = cursor->at >> 6;
+    uint64_t bits = row[word] & (~0ULL << (cursor->at & 63));
+    while (bits == 0) {
+        if (++word >= g->row_words) {
+            cursor->at = cursor->end;
+            return -1;
+        }
+        bits = row[word];
+    }
+    int j = word * 64 + __builtin_ctzll(bits);
+    cursor->at = j + 1;
+    *bidirectional = test_bit(g, g->bidirectional_bits, cursor->device, j);
+    return j;
+}
+
+//Popcounts for bitset rows, a bit test per row for columns
+static void device_degree(Graph *g, int device, int *out_degree, int *in_degree) {
+    if (g->backend == GRAPH_SPARSE) {
+        *out_degree = g->out_start[device + 1] - g->out_start[device];
+        *in_degree = g->in_start[device + 1] - g->in_start[device];
+        return;
+    }
+    uint64_t *row = bit_row(g, g->adjacency_bits, device);
+    *out_degree = 0;
+    for (int w = 0; w < g->row_words; w++) *out_degree += __builtin_popcountll(row[w]);
+    *in_degree = 0;
+    for (int i = 0; i < g->device_count; i++) *in_degree += test_bit(g, g->adjacency_bits, i, device);
+}
+
 void display_adjacency_matrix(Graph *g) {
     if (g->device_count == 0) {
         printf("No devices in the graph.\n");
         return;
     }
+    if (compact_graph(g) != 0) return;
     
     printf("\n!!!!! ADJACENCY MATRIX !!!!!\n");
     
@@ -103,14 +505,19 @@ void display_adjacency_matrix(Graph *g) {
     }
     printf("\n");
     
-    // Print matrix rows
+    // Print matrix rows, walking each sorted row alongside the columns
     for (int i = 0; i < g->device_count; i++) {
         printf("%-5s", g->devices[i].id);
+        ConnectionCursor row;
+        int bidirectional = 0;
+        open_cursor(&row, g, i, 0);
+        int next = next_connection(&row, &bidirectional);
         for (int j = 0; j < g->device_count; j++) {
-            if (g->bidirectional[i][j]) {
-                printf("B    ");
+            if (next == j) {
+                printf(bidirectional ? "B    " : "1    ");
+                next = next_connection(&row, &bidirectional);
             } else {
-                printf("%d    ", g->adjacency_matrix[i][j]);
+                printf("0    ");
             }
         }
         printf("\n");
@@ -125,14 +532,18 @@ void query_device_connections(Graph *g, const char *device_id) {
         printf("Error, Device '%s' not found on the network\n", device_id);
         return;
     }
+    if (compact_graph(g) != 0) return;
     
     printf("\n!!!!! CONNECTIONS FOR %s !!!!!\n", device_id);
+    ConnectionCursor cursor;
+    int i, bidirectional;
     
     //Finding device this sends to.
     printf("Outgoing connections (sends to): ");
     int outgoing_count = 0;
-    for (int i = 0; i < g->device_count; i++) {
-        if (g->adjacency_matrix[device_index][i] && !g->bidirectional[device_index][i]) {
+    open_cursor(&cursor, g, device_index, 0);
+    while ((i = next_connection(&cursor, &bidirectional)) != -1) {
+        if (!bidirectional) {
             printf("%s ", g->devices[i].id);
             outgoing_count++;
         }
@@ -143,8 +554,9 @@ void query_device_connections(Graph *g, const char *device_id) {
     //Find incoming connections (recieving end)
     printf("Incoming connections (receives from): ");
     int incoming_count = 0;
-    for (int i = 0; i < g->device_count; i++) {
-        if (g->adjacency_matrix[i][device_index] && !g->bidirectional[i][device_index]) {
+    open_cursor(&cursor, g, device_index, 1);
+    while ((i = next_connection(&cursor, &bidirectional)) != -1) {
+        if (!bidirectional) {
             printf("%s ", g->devices[i].id);
             incoming_count++;
         }
@@ -154,14 +566,19 @@ void query_device_connections(Graph *g, const char *device_id) {
     
     printf("Bidirectional connections: ");
     int bidirectional_count = 0;
-    for (int i = 0; i < g->device_count; i++) {
-        if (g->bidirectional[device_index][i]) {
+    open_cursor(&cursor, g, device_index, 0);
+    while ((i = next_connection(&cursor, &bidirectional)) != -1) {
+        if (bidirectional) {
             printf("%s ", g->devices[i].id);
             bidirectional_count++;
         }
     }
     if (bidirectional_count == 0) printf("None");
     printf("\n");
+    
+    int out_degree, in_degree;
+    device_degree(g, device_index, &out_degree, &in_degree);
+    printf("Degree: %d out, %d in\n", out_degree, in_degree);
 }
 
 void display_all_connections(Graph *g, const char *device_id) {
@@ -171,23 +588,32 @@ void display_all_connections(Graph *g, const char *device_id) {
         printf("Error: Device '%s' not found in the network.\n", device_id);
         return;
     }
+    if (compact_graph(g) != 0) return;
     
     printf("\n!!!!! ALL DIRECT CONNECTIONS FOR %s !!!!!\n", device_id);
     
+    //Both sides come out sorted, merge them so each neighbour shows up once and in order
+    ConnectionCursor outgoing, incoming;
+    int out_bidirectional = 0, in_bidirectional = 0;
+    open_cursor(&outgoing, g, device_index, 0);
+    open_cursor(&incoming, g, device_index, 1);
+    int next_out = next_connection(&outgoing, &out_bidirectional);
+    int next_in = next_connection(&incoming, &in_bidirectional);
     int connection_count = 0;
-    for (int i = 0; i < g->device_count; i++) {
-        if (g->adjacency_matrix[device_index][i] || g->adjacency_matrix[i][device_index]) {
-            const char* direction = "";
-            if (g->bidirectional[device_index][i]) {
-                direction = " <-> (bidirectional)";
-            } else if (g->adjacency_matrix[device_index][i]) {
-                direction = " -> (sends to)";
-            } else {
-                direction = " <- (receives from)";
-            }
-            printf("- %s%s\n", g->devices[i].id, direction);
-            connection_count++;
+    while (next_out != -1 || next_in != -1) {
+        int i = next_in == -1 || (next_out != -1 && next_out < next_in) ? next_out : next_in;
+        const char* direction = "";
+        if (next_out == i && out_bidirectional) {
+            direction = " <-> (bidirectional)";
+        } else if (next_out == i) {
+            direction = " -> (sends to)";
+        } else {
+            direction = " <- (receives from)";
         }
+        printf("- %s%s\n", g->devices[i].id, direction);
+        connection_count++;
+        if (next_out == i) next_out = next_connection(&outgoing, &out_bidirectional);
+        if (next_in == i) next_in = next_connection(&incoming, &in_bidirectional);
     }
     
     if (connection_count == 0) {
@@ -195,6 +621,137 @@ void display_all_connections(Graph *g, const char *device_id) {
     }
 }
 
+//Devices both send to. For bitsets that's the AND of two rows, 64 devices per step.
+void show_common_neighbours(Graph *g, const char *first, const char *second) {
+    int a = find_device_index(g, first);
+    int b = find_device_index(g, second);
+    
+    if (a == -1 || b == -1) {
+        printf("Error none of the devices have been found\n");
+        return;
+    }
+    if (compact_graph(g) != 0) return;
+    
+    printf("\n!!!!! DEVICES BOTH %s AND %s SEND TO !!!!!\n", first, second);
+    int common_count = 0;
+    if (g->backend == GRAPH_BITSET) {
+        uint64_t *row_a = bit_row(g, g->adjacency_bits, a);
+        uint64_t *row_b = bit_row(g, g->adjacency_bits, b);
+        for (int w = 0; w < g->row_words; w++) {
+            for (uint64_t both = row_a[w] & row_b[w]; both != 0; both &= both - 1) {
+                printf("%s ", g->devices[w * 64 + __builtin_ctzll(both)].id);
+                common_count++;
+            }
+        }
+    } else {
+        //Two sorted rows, walk them together
+        int ea = g->out_start[a], ea_end = g->out_start[a + 1];
+        int eb = g->out_start[b], eb_end = g->out_start[b + 1];
+        while (ea < ea_end && eb < eb_end) {
+            if (g->out_edges[ea].device < g->out_edges[eb].device) {
+                ea++;
+            } else if (g->out_edges[ea].device > g->out_edges[eb].device) {
+                eb++;
+            } else {
+                printf("%s ", g->devices[g->out_edges[ea].device].id);
+                common_count++;
+                ea++;
+                eb++;
+            }
+        }
+    }
+    if (common_count == 0) printf("None");
+    printf("\n");
+}
+
+static int compare_devices(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+//Breadth first from a device, printing what each hop adds. A bitset step ORs the rows
+//of the whole frontier together and masks out what was already reached, 64 devices
+//per word; the sparse one is a plain queue with each hop sorted for printing.
+void show_reachable_devices(Graph *g, const char *device_id, int hops) {
+    int source = find_device_index(g, device_id);
+    
+    if (source == -1) {
+        printf("Error: Device '%s' not found in the network.\n", device_id);
+        return;
+    }
+    if (compact_graph(g) != 0) return;
+    
+    printf("\n!!!!! DEVICES REACHABLE FROM %s !!!!!\n", device_id);
+    int reached = 0;
+    if (g->backend == GRAPH_BITSET) {
+        int words = g->row_words;
+        uint64_t *visited = calloc(3 * (size_t)words, sizeof(uint64_t));
+        if (visited == NULL) {
+            printf("Error: Out of memory.\n");
+            return;
+        }
+        uint64_t *frontier = visited + words;
+        uint64_t *next = frontier + words;
+        visited[source >> 6] = frontier[source >> 6] = 1ULL << (source & 63);
+        for (int hop = 1; hop <= hops; hop++) {
+            memset(next, 0, words * sizeof(uint64_t));
+            for (int w = 0; w < words; w++) {
+                for (uint64_t bits = frontier[w]; bits != 0; bits &= bits - 1) {
+                    uint64_t *row = bit_row(g, g->adjacency_bits, w * 64 + __builtin_ctzll(bits));
+                    for (int k = 0; k < words; k++) next[k] |= row[k];
+                }
+            }
+            int found = 0;
+            for (int w = 0; w < words; w++) {
+                next[w] &= ~visited[w];
+                visited[w] |= next[w];
+                for (uint64_t bits = next[w]; bits != 0; bits &= bits - 1) {
+                    if (found++ == 0) printf("Hop %d: ", hop);
+                    printf("%s ", g->devices[w * 64 + __builtin_ctzll(bits)].id);
+                }
+            }
+            if (found == 0) break;
+            printf("\n");
+            reached += found;
+            memcpy(frontier, next, words * sizeof(uint64_t));
+        }
+        free(visited);
+    } else {
+        int *queue = malloc(g->device_count * sizeof(int));
+        char *visited = calloc(g->device_count, 1);
+        if (queue == NULL || visited == NULL) {
+            free(queue);
+            free(visited);
+            printf("Error: Out of memory.\n");
+            return;
+        }
+        int start = 0, end = 1;
+        queue[0] = source;
+        visited[source] = 1;
+        for (int hop = 1; hop <= hops && start < end; hop++) {
+            int level = end;
+            for (int q = start; q < level; q++) {
+                for (int e = g->out_start[queue[q]]; e < g->out_start[queue[q] + 1]; e++) {
+                    int j = g->out_edges[e].device;
+                    if (!visited[j]) {
+                        visited[j] = 1;
+                        queue[end++] = j;
+                    }
+                }
+            }
+            if (end == level) break;
+            qsort(queue + level, end - level, sizeof(int), compare_devices);
+            printf("Hop %d: ", hop);
+            for (int q = level; q < end; q++) printf("%s ", g->devices[queue[q]].id);
+            printf("\n");
+            reached += end - level;
+            start = level;
+        }
+        free(queue);
+        free(visited);
+    }
+    printf("Devices reached within %d hop(s): %d\n", hops, reached);
+}
+
 void remove_connection(Graph *g, const char *from, const char *to) {
     int from_index = find_device_index(g, from);
     int to_index = find_device_index(g, to);
@@ -204,18 +761,29 @@ void remove_connection(Graph *g, const char *from, const char *to) {
         return;
     }
     
-    if (g->bidirectional[from_index][to_index]) {
-        g->adjacency_matrix[from_index][to_index] = 0;
-        g->adjacency_matrix[to_index][from_index] = 0;
-        g->bidirectional[from_index][to_index] = 0;
-        g->bidirectional[to_index][from_index] = 0;
+    int state = edge_state(g, from_index, to_index);
+    if (state == 2) {
+        clear_edge(g, from_index, to_index);
+        clear_edge(g, to_index, from_index);
         printf("Bidirectional connection between %s and %s stopped.\n", from, to);
-    } else if (g->adjacency_matrix[from_index][to_index]) {
-        g->adjacency_matrix[from_index][to_index] = 0;
+    } else if (state == 1) {
+        clear_edge(g, from_index, to_index);
         printf("Connection from %s to %s removed.\n", from, to);
     } else {
         printf("Error: No connection found from %s to %s.\n", from, to);
     }
+    g->csr_dirty = 1;
+}
+
+//Drops bit position column from a row, everything above it moves down one
+static void delete_bit_column(uint64_t *row, int words, int column) {
+    int w = column >> 6;
+    uint64_t below = (1ULL << (column & 63)) - 1;
+    row[w] = (row[w] & below) | ((row[w] >> 1) & ~below);
+    for (; w + 1 < words; w++) {
+        row[w] |= row[w + 1] << 63;
+        row[w + 1] >>= 1;
+    }
 }
 
 void remove_device(Graph *g, const char *device_id) {
@@ -226,35 +794,62 @@ void remove_device(Graph *g, const char *device_id) {
         return;
     }
     
+    //Out of the ID index, and every device after it moves down one
+    unindex_device(g, pack_device_id(device_id));
+    for (int i = device_index + 1; i < g->device_count; i++) {
+        g->id_devices[id_slot(g, pack_device_id(g->devices[i].id))] = i - 1;
+    }
+    
+    int after = g->device_count - device_index - 1;
+    if (g->backend == GRAPH_BITSET) {
+        //Its row and column go, so do its edges
+        int out_degree, in_degree;
+        device_degree(g, device_index, &out_degree, &in_degree);
+        g->edge_count -= out_degree + in_degree - test_bit(g, g->adjacency_bits, device_index, device_index);
+        size_t row_bytes = g->row_words * sizeof(uint64_t);
+        memmove(bit_row(g, g->adjacency_bits, device_index), bit_row(g, g->adjacency_bits, device_index + 1), after * row_bytes);
+        memmove(bit_row(g, g->bidirectional_bits, device_index), bit_row(g, g->bidirectional_bits, device_index + 1), after * row_bytes);
+        memset(bit_row(g, g->adjacency_bits, g->device_count - 1), 0, row_bytes);
+        memset(bit_row(g, g->bidirectional_bits, g->device_count - 1), 0, row_bytes);
+        for (int i = 0; i < g->device_count - 1; i++) {
+            delete_bit_column(bit_row(g, g->adjacency_bits, i), g->row_words, device_index);
+            delete_bit_column(bit_row(g, g->bidirectional_bits, i), g->row_words, device_index);
+        }
+        memmove(&g->devices[device_index], &g->devices[device_index + 1], after * sizeof(Device));
+        g->device_count--;
+        for (int i = device_index; i < g->device_count; i++) g->devices[i].index = i;
+        printf("Device '%s' removed successfully.\n", device_id);
+        return;
+    }
+    
     //Removed all connections involving this device
-    for (int i = 0; i < g->device_count; i++) {
-        g->adjacency_matrix[device_index][i] = 0;
-        g->adjacency_matrix[i][device_index] = 0;
-        g->bidirectional[device_index][i] = 0;
-        g->bidirectional[i][device_index] = 0;
+    while (g->outgoing[device_index].count > 0) {
+        clear_edge(g, device_index, g->outgoing[device_index].edges[0].device);
+    }
+    while (g->incoming[device_index].count > 0) {
+        clear_edge(g, g->incoming[device_index].edges[0].device, device_index);
     }
+    free(g->outgoing[device_index].edges);
+    free(g->incoming[device_index].edges);
     
     //Shifting device array to remove and make space for other.
-    for (int i = device_index; i < g->device_count - 1; i++) {
-        g->devices[i] = g->devices[i + 1];
-        g->devices[i].index = i;
-    }
+    memmove(&g->devices[device_index], &g->devices[device_index + 1], after * sizeof(Device));
+    memmove(&g->outgoing[device_index], &g->outgoing[device_index + 1], after * sizeof(EdgeList));
+    memmove(&g->incoming[device_index], &g->incoming[device_index + 1], after * sizeof(EdgeList));
+    g->device_count--;
     
-    //Update adjacency matrix ( a bit verbose at this point but we emulating IOT)
-    for (int i = 0; i < g->device_count - 1; i++) {
-        for (int j = device_index; j < g->device_count - 1; j++) {
-            g->adjacency_matrix[i][j] = g->adjacency_matrix[i][j + 1];
-            g->bidirectional[i][j] = g->bidirectional[i][j + 1];
+    //Every device after it moved down one, so renumber the edges pointing at them
+    for (int i = 0; i < g->device_count; i++) {
+        g->devices[i].index = i;
+        for (int e = 0; e < g->outgoing[i].count; e++) {
+            if (g->outgoing[i].edges[e].device > device_index) g->outgoing[i].edges[e].device--;
         }
-    }
-    for (int i = device_index; i < g->device_count - 1; i++) {
-        for (int j = 0; j < g->device_count - 1; j++) {
-            g->adjacency_matrix[i][j] = g->adjacency_matrix[i + 1][j];
-            g->bidirectional[i][j] = g->bidirectional[i + 1][j];
+        for (int e = 0; e < g->incoming[i].count; e++) {
+            if (g->incoming[i].edges[e].device > device_index) g->incoming[i].edges[e].device--;
         }
     }
     
-    g->device_count--;
+    g->csr_dirty = 1;
     printf("Device '%s' removed successfully.\n", device_id);
 }
 
@@ -269,7 +864,9 @@ void print_menu() {
     printf("7. Removing Device\n");
     printf("8. Display All Devices\n");
     printf("9. Exit\n");
-    printf("Enter your choice (1-9): ");
+    printf("10. Common Neighbours of Two Devices\n");
+    printf("11. Devices Reachable Within N Hops\n");
+    printf("Enter your choice (1-11): ");
 }
 
 void initialize_default_connections(Graph *g) {
@@ -288,9 +885,17 @@ void initialize_default_connections(Graph *g) {
     printf("D004 -> D005, D004 -> D006, D005 -> D007, D006 -> D008\n");
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    GraphBackend backend = GRAPH_SPARSE;
+    if (argc == 2 && strcmp(argv[1], "--bitset") == 0) {
+        backend = GRAPH_BITSET;
+    } else if (argc != 1) {
+        printf("Usage: %s [--bitset]\n", argv[0]);
+        return 1;
+    }
+    
     Graph device_graph;
-    initialize_graph(&device_graph);
+    initialize_graph(&device_graph, backend);
     
     //Initializing with default connections
     initialize_default_connections(&device_graph);
@@ -368,10 +973,29 @@ int main() {
                 
             case 9:
                 printf("Goodbye!\n");
+                free_graph(&device_graph);
                 break;
                 
+            case 10:
+                printf("Enter first device ID: ");
+                scanf("%4s", from_device);
+                printf("Enter second device ID: ");
+                scanf("%4s", to_device);
+                show_common_neighbours(&device_graph, from_device, to_device);
+                break;
+                
+            case 11: {
+                int hops = 0;
+                printf("Device ID to start from: ");
+                scanf("%4s", device_id);
+                printf("Maximum hops: ");
+                scanf("%d", &hops);
+                show_reachable_devices(&device_graph, device_id, hops);
+                break;
+            }
+                
             default:
-                printf("Enter a number between 1-9.\n");
+                printf("Enter a number between 1-11.\n");
                 break;
         }
         